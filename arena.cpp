@@ -0,0 +1,189 @@
+#include "arena.h"
+
+#include <new>
+#include <cstdlib>
+#include <algorithm>
+#include <iomanip>
+#include <pugixml.hpp>
+
+namespace
+{
+    std::atomic<uint64_t> allocationCount(0);
+    std::atomic<uint64_t> byteCount(0);
+    std::atomic<uint64_t> blockCount(0);
+    std::atomic<uint64_t> resetCount(0);
+    std::atomic<uint64_t> highWater(0);
+    std::atomic<uint64_t> reserved(0);
+    std::atomic<uint64_t> peakReserved(0);
+
+    thread_local arena* active = nullptr;
+
+    void raise(std::atomic<uint64_t>& peak, uint64_t value)
+    {
+        uint64_t seen = peak.load(std::memory_order_relaxed);
+        while (seen < value && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    /*
+     * The hooks are process wide, so a DOM that is not loaded inside an arena::scope still goes
+     * to malloc.  A header in front of every block tells deallocate which one to free.
+     */
+    constexpr size_t HEADER = 16;
+    constexpr uint64_t HEAP = 0;
+    constexpr uint64_t ARENA = 1;
+
+    void* allocateHook(size_t size)
+    {
+        char* p = nullptr;
+        try
+        {
+            p = static_cast<char*>(active ? active->allocate(size + HEADER) : std::malloc(size + HEADER));
+        }
+        catch (const std::bad_alloc&)
+        {
+            return nullptr;
+        }
+        if (!p)
+        {
+            return nullptr;
+        }
+        *reinterpret_cast<uint64_t*>(p) = active ? ARENA : HEAP;
+        return p + HEADER;
+    }
+
+    void deallocateHook(void* ptr)
+    {
+        if (!ptr)
+        {
+            return;
+        }
+        char* p = static_cast<char*>(ptr) - HEADER;
+        if (*reinterpret_cast<uint64_t*>(p) == HEAP)
+        {
+            std::free(p);
+        }
+    }
+
+    /* installed before main, so that no DOM is allocated without a header */
+    struct installer
+    {
+        installer()
+        {
+            pugi::set_memory_management_functions(allocateHook, deallocateHook);
+        }
+    } install;
+}
+
+arena::arena()
+{
+    current = 0;
+    used = 0;
+    inUse = 0;
+}
+
+arena::~arena()
+{
+    for (auto const& b : blocks)
+    {
+        reserved.fetch_sub(b.size, std::memory_order_relaxed);
+    }
+}
+
+void* arena::allocate(size_t size)
+{
+    size = (size + 15) & ~size_t(15);
+
+    if (blocks.empty() || used + size > blocks[current].size)
+    {
+        // blocks kept from before the last reset are used first
+        while (current + 1 < blocks.size())
+        {
+            current++;
+            used = 0;
+            if (size <= blocks[current].size)
+            {
+                break;
+            }
+        }
+        if (blocks.empty() || used + size > blocks[current].size)
+        {
+            size_t next = std::min(BLOCK_SIZE << blocks.size(), MAX_BLOCK_SIZE);
+            block b;
+            b.size = std::max(next, size);
+            b.data.reset(new char[b.size]);
+            blocks.push_back(std::move(b));
+            current = blocks.size() - 1;
+            used = 0;
+
+            blockCount.fetch_add(1, std::memory_order_relaxed);
+            raise(peakReserved, reserved.fetch_add(blocks.back().size, std::memory_order_relaxed) + blocks.back().size);
+        }
+    }
+
+    void* p = blocks[current].data.get() + used;
+    used += size;
+    inUse += size;
+
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    byteCount.fetch_add(size, std::memory_order_relaxed);
+    raise(highWater, inUse);
+    return p;
+}
+
+void arena::reset()
+{
+    current = 0;
+    used = 0;
+    inUse = 0;
+    resetCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::shared_ptr<arena> arena::acquire()
+{
+    thread_local std::shared_ptr<arena> local;
+    if (local && local.use_count() == 1)
+    {
+        local->reset();
+    }
+    else
+    {
+        // the previous arena lives on with the projects that still use it
+        local = std::make_shared<arena>();
+    }
+    return local;
+}
+
+arena::scope::scope(arena& a)
+{
+    previous = active;
+    active = &a;
+}
+
+arena::scope::~scope()
+{
+    active = previous;
+}
+
+arena::statistics arena::getStatistics()
+{
+    statistics s;
+    s.allocations = allocationCount.load(std::memory_order_relaxed);
+    s.bytes = byteCount.load(std::memory_order_relaxed);
+    s.blocks = blockCount.load(std::memory_order_relaxed);
+    s.resets = resetCount.load(std::memory_order_relaxed);
+    s.highWater = highWater.load(std::memory_order_relaxed);
+    s.reserved = reserved.load(std::memory_order_relaxed);
+    s.peakReserved = peakReserved.load(std::memory_order_relaxed);
+    return s;
+}
+
+void arena::printStatistics(std::ostream& os)
+{
+    statistics s = getStatistics();
+    os << "DOM arena: " << s.allocations << " allocations, " << std::fixed << std::setprecision(1)
+       << s.bytes / 1024.0 << " KB, " << s.blocks << " blocks, " << s.resets << " resets, high-water "
+       << s.highWater / 1024.0 << " KB, reserved " << s.reserved / 1024.0 << " KB (peak "
+       << s.peakReserved / 1024.0 << " KB)" << std::endl;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Bump allocator for the pugixml DOM.  Nothing is freed one by one: an arena is rewound as a
+ * whole when the next project on its thread is loaded, keeping its blocks, so converting many
+ * projects reaches a steady state without touching malloc.  Each thread has its own arena,
+ * held by a project while it is loaded; a thread gets a fresh one while it is still held.
+ */
+class arena
+{
+public:
+    struct statistics
+    {
+        uint64_t allocations;
+        uint64_t bytes;
+        uint64_t blocks;
+        uint64_t resets;
+        uint64_t highWater;
+        uint64_t reserved;
+        uint64_t peakReserved;
+    };
+
+    arena();
+    ~arena();
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    void* allocate(size_t size);
+    void reset();
+
+    /* the arena of this thread, rewound when no project uses it any more */
+    static std::shared_ptr<arena> acquire();
+
+    /* pugixml allocates from a while the scope lives */
+    class scope
+    {
+    public:
+        scope(arena& a);
+        ~scope();
+
+    private:
+        arena* previous;
+    };
+
+    static statistics getStatistics();
+    static void printStatistics(std::ostream& os);
+
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t MAX_BLOCK_SIZE = 1024 * 1024;
+
+private:
+    struct block
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    std::vector<block> blocks;
+    size_t current;
+    size_t used;
+    size_t inUse;
+};
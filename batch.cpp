@@ -0,0 +1,304 @@
+#include "batch.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <dirent.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include <cstring>
+
+#include "project.h"
+#include "utilities.h"
+#include "profiler.h"
+
+
+batch::batch()
+{
+    jobs = std::thread::hardware_concurrency();
+    if(jobs == 0)
+    {
+        jobs = 1;
+    }
+    verbose = false;
+    check = false;
+}
+
+void batch::setJobs(unsigned int count)
+{
+    if(count != 0)
+    {
+        jobs = count;
+    }
+}
+
+void batch::setVerbose(bool enable)
+{
+    verbose = enable;
+}
+
+void batch::setCheck(bool enable)
+{
+    check = enable;
+}
+
+void batch::setOptions(const project::options &o)
+{
+    opts = o;
+}
+
+size_t batch::size()
+{
+    return inputs.size();
+}
+
+const std::vector<std::string>& batch::getInputs()
+{
+    return inputs;
+}
+
+void batch::addProject(std::string path)
+{
+    if(std::find(inputs.begin(), inputs.end(), path) == inputs.end())
+    {
+        inputs.push_back(path);
+    }
+}
+
+void batch::findProjectsRecursively(std::string basePath)
+{
+    DIR *dir = opendir(basePath.c_str());
+    if (!dir)
+    {
+        return;
+    }
+
+    std::vector<std::string> subdirs;
+    struct dirent *dp;
+    while ((dp = readdir(dir)) != NULL)
+    {
+        // skips ".", ".." and hidden folders such as .git
+        if (dp->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        std::string path = basePath + "/" + dp->d_name;
+
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+        {
+            continue;
+        }
+
+        if (S_ISDIR(info.st_mode))
+        {
+            subdirs.push_back(path);
+        }
+        else if (S_ISREG(info.st_mode))
+        {
+            size_t len = strlen(dp->d_name);
+            if (len > 6 && strcmp(dp->d_name + len - 6, ".jucer") == 0)
+            {
+                addProject(path);
+            }
+        }
+    }
+
+    closedir(dir);
+
+    std::sort(subdirs.begin(), subdirs.end());
+    for(auto const& path : subdirs)
+    {
+        findProjectsRecursively(path);
+    }
+}
+
+void batch::addDirectory(std::string path)
+{
+    while(path.length() > 1 && path.back() == '/')
+    {
+        path.pop_back();
+    }
+    findProjectsRecursively(path);
+}
+
+void batch::addInput(std::string pattern)
+{
+    glob_t g;
+    if (glob(pattern.c_str(), 0, NULL, &g) != 0)
+    {
+        missing.push_back(pattern);
+        return;
+    }
+
+    for (size_t i = 0; i < g.gl_pathc; i++)
+    {
+        std::string path = g.gl_pathv[i];
+
+        struct stat info;
+        if (stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+        {
+            addDirectory(path);
+        }
+        else
+        {
+            addProject(path);
+        }
+    }
+
+    globfree(&g);
+}
+
+void batch::addListFile(std::string path)
+{
+    std::ifstream is(path);
+    if (!is)
+    {
+        throw std::runtime_error("Error opening file: " + path);
+    }
+
+    std::string line;
+    while (std::getline(is, line))
+    {
+        std::string_view entry = utilities::trim(line);
+        if (entry.empty() || entry[0] == '#')
+        {
+            continue;
+        }
+        addInput(std::string(entry));
+    }
+}
+
+batch::result batch::convert(std::string input)
+{
+    result res;
+    res.input = input;
+    res.success = false;
+    res.changed = false;
+
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        profiler::scope s("convert", input);
+        // the workers run in parallel, their output is kept for the summary
+        project proj(input, "", opts, [&res](const project::diagnostic &d)
+        {
+            res.diagnostics.push_back(d);
+        });
+        res.changed = proj.generate(check);
+        if(verbose)
+        {
+            std::stringstream ss;
+            proj.print(ss);
+            res.details = ss.str();
+        }
+        res.output = proj.get_output_file();
+        res.success = true;
+    }
+    catch (const std::exception& e)
+    {
+        res.error = e.what();
+    }
+    auto end = std::chrono::steady_clock::now();
+    res.seconds = std::chrono::duration<double>(end - start).count();
+
+    return res;
+}
+
+int batch::run()
+{
+    results.clear();
+    results.resize(inputs.size());
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        size_t i;
+        while ((i = next++) < inputs.size())
+        {
+            results[i] = convert(inputs[i]);
+        }
+    };
+
+    unsigned int count = std::min<size_t>(jobs, inputs.size());
+    std::vector<std::thread> pool;
+    for (unsigned int i = 1; i < count; i++)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : pool)
+    {
+        t.join();
+    }
+
+    int failures = missing.size();
+    for (auto const& res : results)
+    {
+        if (!res.success)
+        {
+            failures++;
+        }
+    }
+    return failures;
+}
+
+size_t batch::changed()
+{
+    size_t count = 0;
+    for (auto const& res : results)
+    {
+        if (res.success && res.changed)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+void batch::printSummary(std::ostream& os)
+{
+    size_t converted = 0;
+    size_t failures = missing.size();
+
+    os << "\n** Summary **\n";
+    for (auto const& pattern : missing)
+    {
+        os << "FAILED  " << pattern << " : no matching .jucer files\n";
+    }
+    for (auto const& res : results)
+    {
+        if (verbose && !res.details.empty())
+        {
+            os << res.details;
+        }
+        for (auto const& d : res.diagnostics)
+        {
+            // notes are what a single conversion prints, only shown with --verbose
+            if (verbose || d.level != project::diagnostic::note)
+            {
+                os << (d.level == project::diagnostic::error ? "    error: " : d.level == project::diagnostic::warning ? "    warning: " : "    ")
+                   << project::format_diagnostic(d) << "\n";
+            }
+        }
+        if (res.success)
+        {
+            const char* status = res.changed ? (check ? "STALE   " : "OK      ") : "SAME    ";
+            os << status << res.input << " (" << std::fixed << std::setprecision(3) << res.seconds << "s)\n";
+            converted++;
+        }
+        else
+        {
+            os << "FAILED  " << res.input << " : " << res.error << "\n";
+            failures++;
+        }
+    }
+    os << converted << " converted, " << changed() << (check ? " out of date, " : " changed, ") << failures << " failed, " << jobs << " jobs\n";
+}
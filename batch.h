@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "project.h"
+
+class batch
+{
+public:
+
+    struct result
+    {
+        std::string input;
+        std::string output;
+        bool success;
+        bool changed;
+        std::string error;
+        double seconds;
+        /* collected while converting, printed with the summary in input order */
+        std::vector<project::diagnostic> diagnostics;
+        std::string details;
+    };
+
+    batch();
+
+    void addInput(std::string pattern);
+    void addListFile(std::string path);
+    void addDirectory(std::string path);
+    void setJobs(unsigned int count);
+    void setVerbose(bool enable);
+    void setCheck(bool enable);
+    void setOptions(const project::options &o);
+
+    size_t size();
+    const std::vector<std::string>& getInputs();
+    int run();
+    size_t changed();
+    void printSummary(std::ostream& os);
+
+private:
+    void addProject(std::string path);
+    void findProjectsRecursively(std::string basePath);
+    result convert(std::string input);
+
+    std::vector<std::string> inputs;
+    std::vector<result> results;
+    std::vector<std::string> missing;
+    unsigned int jobs;
+    bool verbose;
+    bool check;
+    project::options opts;
+};
@@ -0,0 +1,466 @@
+/*
+ * Times the phases of a conversion on a synthetic project: the .jucer load, module discovery,
+ * every emitter, the input hash and the file write.  Each phase is reported as the median over
+ * the runs together with its median allocation count and allocated bytes.
+ *
+ *   j2c_bench [-n runs] [--files n] [--depth n] [--modules n] [--exporters n] [--resources n]
+ *             [--unity] [--pch] [--compiler-cache] [--dir path] [--keep]
+ *
+ * The project and a module tree are generated in --dir (a temporary folder by default, removed
+ * at the end unless --keep is given).  Module discovery starts from an empty index every run.
+ */
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <ftw.h>
+#include <unistd.h>
+
+#include "project.h"
+#include "arena.h"
+#include "moduleindex.h"
+#include "utilities.h"
+
+namespace
+{
+    std::atomic<uint64_t> allocations(0);
+    std::atomic<uint64_t> allocatedBytes(0);
+
+    void* allocate(size_t n)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocatedBytes.fetch_add(n, std::memory_order_relaxed);
+        return malloc(n ? n : 1);
+    }
+}
+
+// out of line, so that the compiler does not pair a free() with an inlined operator new
+void* operator new(size_t n)
+{
+    void* p = allocate(n);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t n)
+{
+    return operator new(n);
+}
+
+void* operator new(size_t n, const std::nothrow_t&) noexcept
+{
+    return allocate(n);
+}
+
+void* operator new[](size_t n, const std::nothrow_t&) noexcept
+{
+    return allocate(n);
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+namespace
+{
+    /* a .jucer with nested groups, resources, modules and exporters, and the files it refers to */
+    struct synthetic
+    {
+        int files = 1000;
+        int depth = 4;
+        int modules = 30;
+        int exporters = 4;
+        int resources = 20;
+
+        std::string moduleId(int i)
+        {
+            return "synth_module_" + std::to_string(i);
+        }
+
+        void writeFile(const std::string& path, size_t size, char fill)
+        {
+            size_t slash = path.find_last_of('/');
+            utilities::makeDirectories(path.substr(0, slash));
+            std::ofstream os(path, std::ios::binary);
+            os << std::string(size, fill);
+        }
+
+        /* JUCE style module headers; every fifth module sits below a vendor folder so that it is found by the walk */
+        void writeModules(const std::string& root)
+        {
+            for (int i = 0; i < modules; i++)
+            {
+                std::string id = moduleId(i);
+                std::string dir = root + ((i % 5 == 4) ? "/vendor" + std::to_string(i % 3) + "/" : "/") + id;
+
+                std::stringstream ss;
+                ss << "/*\n BEGIN_JUCE_MODULE_DECLARATION\n\n";
+                ss << "  ID:               " << id << "\n";
+                ss << "  vendor:           synthetic\n";
+                ss << "  version:          1.0." << i << "\n";
+                ss << "  name:             Synthetic module " << i << "\n";
+                ss << "  description:      Generated by j2c_bench\n";
+                ss << "  website:          http://example.com\n";
+                ss << "  license:          ISC\n\n";
+                ss << "  dependencies:     " << (i > 0 ? moduleId(i - 1) : "") << (i > 1 ? ", " + moduleId(i - 2) : "") << "\n";
+                ss << "  OSXFrameworks:    Cocoa IOKit\n";
+                ss << "  iOSFrameworks:    UIKit\n";
+                ss << "  linuxLibs:        rt dl pthread\n";
+                ss << "  linuxPackages:    x11 xinerama xext freetype2\n";
+                ss << "  mingwLibs:        ws2_32 winmm\n\n";
+                ss << " END_JUCE_MODULE_DECLARATION\n*/\n\n#pragma once\n";
+                ss << std::string(2000, '/') << "\n";
+
+                utilities::makeDirectories(dir);
+                utilities::writeFileAtomic(dir + "/" + id + ".h", ss.str());
+                for (int k = 0; k < 8; k++)
+                {
+                    writeFile(dir + "/detail/" + id + "_" + std::to_string(k) + ".cpp", 256, ' ');
+                }
+            }
+        }
+
+        void writeGroup(std::stringstream& ss, const std::string& dir, const std::string& path, int level, int& next, int& id, int groups)
+        {
+            std::string indent(2 * level + 2, ' ');
+            int count = files / groups + ((id % groups) < (files % groups) ? 1 : 0);
+            id++;
+            for (int i = 0; i < count && next < files; i++, next++)
+            {
+                bool source = (next % 3) != 2;
+                std::string name = "File" + std::to_string(next) + (source ? ".cpp" : ".h");
+                ss << indent << "  <FILE id=\"f" << next << "\" name=\"" << name << "\" compile=\"" << source
+                   << "\" resource=\"0\" file=\"" << path << "/" << name << "\"/>\n";
+                writeFile(dir + "/" + path + "/" + name, 200 + (next * 37) % 4000, ' ');
+            }
+            if (level < depth)
+            {
+                for (int g = 0; g < 2; g++)
+                {
+                    std::string sub = "Group" + std::to_string(level) + "_" + std::to_string(g);
+                    ss << indent << "  <GROUP id=\"g" << id << "\" name=\"" << sub << "\">\n";
+                    writeGroup(ss, dir, path + "/" + sub, level + 1, next, id, groups);
+                    ss << indent << "  </GROUP>\n";
+                }
+            }
+        }
+
+        /* returns the path of the .jucer */
+        std::string generate(const std::string& dir)
+        {
+            static const char* formats[] = { "LINUX_MAKE", "XCODE_MAC", "VS2019", "VS2017", "XCODE_IPHONE", "VS2015" };
+
+            writeModules(dir + "/modules");
+
+            std::string projectDir = dir + "/Synthetic";
+            std::stringstream ss;
+            ss << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\n";
+            ss << "<JUCERPROJECT id=\"synth\" name=\"Synthetic\" projectType=\"audioplug\" version=\"1.0.0\" jucerVersion=\"5.4.7\"\n";
+            ss << "              headerPath=\"../include&#10;/opt/include\" cppLanguageStandard=\"17\" companyName=\"Bench\"\n";
+            ss << "              pluginFormats=\"buildVST3,buildAU,buildStandalone\" defines=\"SYNTH=1&#10;BENCH=2\">\n";
+            ss << "  <MAINGROUP id=\"m\" name=\"Synthetic\">\n";
+            ss << "    <GROUP id=\"g0\" name=\"Source\">\n";
+            int next = 0;
+            int id = 1;
+            int groups = (1 << (depth + 1)) - 1;
+            writeGroup(ss, projectDir, "Source", 0, next, id, groups);
+            ss << "    </GROUP>\n";
+            ss << "    <GROUP id=\"r\" name=\"Resources\">\n";
+            for (int i = 0; i < resources; i++)
+            {
+                std::string name = "resource" + std::to_string(i) + ((i % 2) ? ".png" : ".txt");
+                ss << "      <FILE id=\"r" << i << "\" name=\"" << name << "\" compile=\"0\" resource=\"1\" file=\"Resources/" << name << "\"/>\n";
+                writeFile(projectDir + "/Resources/" + name, 1000 + i * 5000, 'r');
+            }
+            ss << "    </GROUP>\n";
+            ss << "  </MAINGROUP>\n";
+            ss << "  <EXPORTFORMATS>\n";
+            for (int e = 0; e < exporters; e++)
+            {
+                std::string format = formats[e % 6];
+                ss << "    <" << format << " targetFolder=\"Builds/" << format << e << "\" externalLibraries=\"sndfile&#10;asound\""
+                   << " extraDefs=\"EXPORTER=" << e << "\" extraCompilerFlags=\"-Wall -Wextra\" extraLinkerFlags=\"-Wl,--as-needed\">\n";
+                ss << "      <CONFIGURATIONS>\n";
+                ss << "        <CONFIGURATION isDebug=\"1\" name=\"Debug\" headerPath=\"/usr/include/sdk&#10;../sdk\" libraryPath=\"/usr/local/lib\"/>\n";
+                ss << "        <CONFIGURATION isDebug=\"0\" name=\"Release\" optimisation=\"3\"/>\n";
+                ss << "      </CONFIGURATIONS>\n";
+                ss << "      <MODULEPATHS>\n";
+                for (int i = 0; i < modules; i++)
+                {
+                    ss << "        <MODULEPATH id=\"" << moduleId(i) << "\" path=\"../modules\"/>\n";
+                }
+                ss << "      </MODULEPATHS>\n";
+                ss << "    </" << format << ">\n";
+            }
+            ss << "  </EXPORTFORMATS>\n";
+            ss << "  <MODULES>\n";
+            for (int i = 0; i < modules; i++)
+            {
+                ss << "    <MODULE id=\"" << moduleId(i) << "\" showAllCode=\"1\" useLocalCopy=\"0\" useGlobalPath=\"0\"/>\n";
+            }
+            ss << "  </MODULES>\n";
+            ss << "  <JUCEOPTIONS/>\n";
+            ss << "</JUCERPROJECT>\n";
+
+            utilities::makeDirectories(projectDir + "/JuceLibraryCode");
+            std::string jucer = projectDir + "/Synthetic.jucer";
+            utilities::writeFileAtomic(jucer, ss.str());
+            return jucer;
+        }
+    };
+
+    struct phase
+    {
+        std::string name;
+        std::vector<double> ns;
+        std::vector<uint64_t> allocations;
+        std::vector<uint64_t> bytes;
+    };
+
+    template <typename T>
+    T median(std::vector<T> v)
+    {
+        std::sort(v.begin(), v.end());
+        return v.empty() ? T() : v[v.size() / 2];
+    }
+
+    int removeEntry(const char* path, const struct stat*, int, struct FTW*)
+    {
+        return ::remove(path);
+    }
+}
+
+/* friend of project, calls the phases of project::gen_cmake one at a time */
+class projectBenchmark
+{
+public:
+    std::vector<phase> phases;
+
+    template <typename F>
+    void measure(size_t index, const char* name, F f)
+    {
+        if (phases.size() <= index)
+        {
+            phases.push_back({ name, {}, {}, {} });
+        }
+        uint64_t a = allocations.load();
+        uint64_t b = allocatedBytes.load();
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        phases[index].ns.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        phases[index].allocations.push_back(allocations.load() - a);
+        phases[index].bytes.push_back(allocatedBytes.load() - b);
+    }
+
+    void run(const std::string& jucer, const std::string& output, const std::string& index, const project::options& opts)
+    {
+        // cold module discovery: no index file and nothing in memory
+        ::remove(index.c_str());
+        moduleIndex::setFile(index);
+        moduleIndex::instance().reset();
+
+        std::unique_ptr<project> proj;
+        size_t i = 0;
+        std::string out;
+        auto ignore = [](const project::diagnostic&) {};
+
+        measure(i++, "xml load", [&]() { proj.reset(new project(jucer, output, opts, ignore)); });
+        measure(i++, "module discovery", [&]() { proj->resolve_modules(); });
+        measure(i++, "module lookup (warm)", [&]()
+        {
+            proj->juceModules.clear();
+            proj->modulesResolved = false;
+            proj->resolve_modules();
+        });
+        measure(i++, "get_input_hash", [&]() { out = proj->get_input_hash(); });
+
+        out.clear();
+        measure(i++, "get_header", [&]() { out += proj->get_header(); });
+        measure(i++, "get_dependencies", [&]() { out += proj->get_dependencies(); });
+        measure(i++, "get_cpp_standard", [&]() { out += proj->get_cpp_standard(); });
+        if (opts.compilerCache)
+        {
+            measure(i++, "get_compiler_cache", [&]() { out += proj->get_compiler_cache(); });
+        }
+        measure(i++, "get_defines", [&]() { out += proj->get_defines(); });
+        measure(i++, "get_include_dirs", [&]() { out += proj->get_include_dirs(); });
+        measure(i++, "get_autogen_vars", [&]() { out += proj->get_autogen_vars(); });
+        measure(i++, "get_resource_files", [&]() { out += proj->get_resource_files(); });
+        measure(i++, "get_source_list", [&]() { out += proj->get_source_list(); });
+        measure(i++, "get_module_libraries", [&]() { out += proj->get_module_libraries(); });
+        measure(i++, "get_executable", [&]() { out += proj->get_executable(); });
+        measure(i++, "get_common_options", [&]() { out += proj->get_common_options(); });
+        measure(i++, "get_target_config", [&]() { out += proj->get_target_config(); });
+        measure(i++, "file write", [&]() { utilities::writeFileAtomic(proj->get_cmake_file(), out); });
+
+        outputSize = out.size();
+    }
+
+    size_t outputSize = 0;
+};
+
+int main(int argc, char* argv[])
+{
+    int runs = 20;
+    bool keep = false;
+    std::string dir;
+    synthetic gen;
+    project::options opts;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool value = (i + 1 < argc);
+        if (arg == "-n" && value)
+        {
+            runs = std::atoi(argv[++i]);
+        }
+        else if (arg == "--files" && value)
+        {
+            gen.files = std::atoi(argv[++i]);
+        }
+        else if (arg == "--depth" && value)
+        {
+            gen.depth = std::atoi(argv[++i]);
+        }
+        else if (arg == "--modules" && value)
+        {
+            gen.modules = std::atoi(argv[++i]);
+        }
+        else if (arg == "--exporters" && value)
+        {
+            gen.exporters = std::atoi(argv[++i]);
+        }
+        else if (arg == "--resources" && value)
+        {
+            gen.resources = std::atoi(argv[++i]);
+        }
+        else if (arg == "--dir" && value)
+        {
+            dir = argv[++i];
+        }
+        else if (arg == "--unity")
+        {
+            opts.unity = true;
+        }
+        else if (arg == "--pch")
+        {
+            opts.precompiledHeader = true;
+        }
+        else if (arg == "--compiler-cache")
+        {
+            opts.compilerCache = true;
+        }
+        else if (arg == "--keep")
+        {
+            keep = true;
+        }
+        else
+        {
+            std::cerr << "usage: j2c_bench [-n runs] [--files n] [--depth n] [--modules n] [--exporters n] [--resources n]\n"
+                      << "                 [--unity] [--pch] [--compiler-cache] [--dir path] [--keep]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (runs <= 0 || gen.files < 0 || gen.depth < 0 || gen.depth > 16 || gen.modules < 0 || gen.exporters < 0 || gen.resources < 0)
+    {
+        std::cerr << "invalid arguments" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (dir.empty())
+    {
+        char tmp[] = "/tmp/j2c_bench.XXXXXX";
+        if (!mkdtemp(tmp))
+        {
+            std::cerr << "cannot create a temporary folder" << std::endl;
+            return EXIT_FAILURE;
+        }
+        dir = tmp;
+    }
+    else
+    {
+        keep = true;
+        utilities::makeDirectories(dir);
+    }
+
+    std::string jucer = gen.generate(dir);
+    std::string output = dir + "/out";
+    utilities::makeDirectories(output);
+
+    projectBenchmark bench;
+    try
+    {
+        for (int r = 0; r < runs; r++)
+        {
+            bench.run(jucer, output, dir + "/modules.index", opts);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << gen.files << " files in groups " << gen.depth << " deep, " << gen.resources << " resources, "
+              << gen.modules << " modules, " << gen.exporters << " exporters, " << runs << " runs, "
+              << bench.outputSize << " bytes of output\n\n";
+    std::cout << std::left << std::setw(24) << "phase" << std::right << std::setw(12) << "median us" << std::setw(12) << "min us"
+              << std::setw(12) << "allocs" << std::setw(12) << "KB" << "\n";
+
+    double total = 0;
+    uint64_t totalAllocations = 0;
+    uint64_t totalBytes = 0;
+    for (auto const& p : bench.phases)
+    {
+        double m = median(p.ns) / 1000;
+        if (p.name != "module lookup (warm)")
+        {
+            total += m;
+            totalAllocations += median(p.allocations);
+            totalBytes += median(p.bytes);
+        }
+        std::cout << std::left << std::setw(24) << p.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << m << std::setw(12) << *std::min_element(p.ns.begin(), p.ns.end()) / 1000
+                  << std::setw(12) << median(p.allocations) << std::setw(12) << median(p.bytes) / 1024 << "\n";
+    }
+    std::cout << std::left << std::setw(24) << "total (cold)" << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << total << std::setw(12) << "" << std::setw(12) << totalAllocations << std::setw(12) << totalBytes / 1024 << std::endl;
+    arena::printStatistics(std::cout);
+
+    if (!keep)
+    {
+        nftw(dir.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+    return EXIT_SUCCESS;
+}
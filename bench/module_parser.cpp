@@ -0,0 +1,142 @@
+/*
+ * Compares the module declaration parser against the previous std::getline based one.
+ *
+ *   bench_module_parser [-n iterations] <module header>...
+ *
+ * e.g. bench_module_parser ~/JUCE/modules/juce_*\/juce_*.h
+ */
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <map>
+#include <cstdlib>
+
+#include "module.h"
+#include "legacy_utilities.h"
+
+namespace
+{
+    typedef std::map<std::string, std::string> map_t;
+
+    /* the parser before the memory mapped scanner */
+    map_t legacyParse(const std::string& inpfile)
+    {
+        map_t metaData;
+        enum { start, begin, end } state = start;
+        std::stringstream ss;
+
+        std::ifstream is(inpfile);
+        std::string line;
+        while (std::getline(is, line))
+        {
+            if (state == start)
+            {
+                if (line.find("BEGIN_JUCE_MODULE_DECLARATION") != std::string::npos)
+                {
+                    state = begin;
+                }
+            }
+            else if (state == begin)
+            {
+                if (line.find("END_JUCE_MODULE_DECLARATION") != std::string::npos)
+                {
+                    state = end;
+                }
+                else
+                {
+                    ss << line << " \n";
+                }
+            }
+        }
+
+        std::string key;
+        for (auto &l : legacy::split(ss.str(), '\n'))
+        {
+            size_t colon = l.find(':');
+            if (colon != std::string::npos)
+            {
+                key = legacy::trim(l.substr(0, colon));
+                metaData[key] = legacy::trim(l.substr(colon + 1));
+            }
+            else
+            {
+                l = legacy::trim(l);
+                if (!key.empty() && !l.empty())
+                {
+                    std::replace(l.begin(), l.end(), ',', ' ');
+                    metaData[key] += " " + l;
+                }
+            }
+        }
+        return metaData;
+    }
+
+    template <typename F>
+    double nsPerCall(int iterations, F f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            f();
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int iterations = 2000;
+    std::vector<std::string> headers;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc)
+        {
+            iterations = std::atoi(argv[++i]);
+        }
+        else
+        {
+            headers.push_back(arg);
+        }
+    }
+
+    if (headers.empty() || iterations <= 0)
+    {
+        std::cerr << "usage: bench_module_parser [-n iterations] <module header>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    double legacyTotal = 0;
+    double mappedTotal = 0;
+
+    std::cout << std::left << std::setw(40) << "header" << std::right << std::setw(14) << "getline ns" << std::setw(14) << "mapped ns" << std::setw(10) << "speedup" << "\n";
+    for (auto const& header : headers)
+    {
+        if (legacyParse(header) != module(header).getMetaData())
+        {
+            std::cerr << "parsers disagree on " << header << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        double legacy = nsPerCall(iterations, [&]() { legacyParse(header); });
+        double mapped = nsPerCall(iterations, [&]() { module m(header); });
+        legacyTotal += legacy;
+        mappedTotal += mapped;
+
+        std::string name = header.substr(header.find_last_of('/') + 1);
+        std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(14) << legacy << std::setw(14) << mapped
+                  << std::setw(9) << std::setprecision(2) << legacy / mapped << "x\n";
+    }
+
+    std::cout << std::left << std::setw(40) << "total" << std::right << std::fixed << std::setprecision(0)
+              << std::setw(14) << legacyTotal << std::setw(14) << mappedTotal
+              << std::setw(9) << std::setprecision(2) << legacyTotal / mappedTotal << "x\n";
+
+    return EXIT_SUCCESS;
+}
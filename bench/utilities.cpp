@@ -0,0 +1,111 @@
+/*
+ * Compares the string_view based helpers in utilities.h against the previous
+ * std::string / istringstream based ones on typical jucer2cmake inputs.
+ *
+ *   bench_utilities [-n iterations]
+ */
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+
+#include "utilities.h"
+#include "legacy_utilities.h"
+
+namespace
+{
+    const std::string TRIM_INPUT = "   juce_gui_basics, juce_audio_devices  \t\n";
+    const std::string SPLIT_INPUT = "../../JUCE/modules\n../extra/include\n/opt/include\n/usr/local/include\n";
+    const std::string LIST_INPUT = "  juce_audio_basics,  juce_audio_devices, juce_audio_formats, "
+                                   "juce_audio_processors  juce_gui_extra,juce_opengl    juce_dsp  ";
+    const std::string PATH_INPUT = "/home/user/src/project/Builds/LinuxMakefile/../../../JUCE/./modules//juce_core/juce_core.h";
+
+    template <typename F>
+    double nsPerCall(int iterations, F f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            f();
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    }
+
+    template <typename A, typename B>
+    bool sameTokens(const A& a, const B& b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (std::string(a[i]) != std::string(b[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void report(const char* name, double before, double after)
+    {
+        std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << before << std::setw(14) << after
+                  << std::setw(9) << std::setprecision(2) << before / after << "x\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int iterations = 1000000;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc)
+        {
+            iterations = std::atoi(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "usage: bench_utilities [-n iterations]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::string path = PATH_INPUT;
+    utilities::normalizePath(path);
+    std::string legacyPath = PATH_INPUT;
+    if (legacy::trim(TRIM_INPUT) != utilities::trim(TRIM_INPUT)
+        || !sameTokens(legacy::split(SPLIT_INPUT, '\n'), utilities::split(SPLIT_INPUT, '\n'))
+        || !sameTokens(legacy::getValueList(LIST_INPUT), utilities::getValueList(LIST_INPUT))
+        || legacy::normalizePath(legacyPath) != path)
+    {
+        std::cerr << "implementations disagree" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the results are accumulated so the calls cannot be optimized away
+    size_t sink = 0;
+
+    std::cout << std::left << std::setw(16) << "function" << std::right << std::setw(14) << "before ns" << std::setw(14) << "after ns" << std::setw(10) << "speedup" << "\n";
+
+    report("trim",
+           nsPerCall(iterations, [&]() { sink += legacy::trim(TRIM_INPUT).size(); }),
+           nsPerCall(iterations, [&]() { sink += utilities::trim(TRIM_INPUT).size(); }));
+
+    report("split",
+           nsPerCall(iterations, [&]() { sink += legacy::split(SPLIT_INPUT, '\n').size(); }),
+           nsPerCall(iterations, [&]() { sink += utilities::split(SPLIT_INPUT, '\n').size(); }));
+
+    report("getValueList",
+           nsPerCall(iterations, [&]() { sink += legacy::getValueList(LIST_INPUT).size(); }),
+           nsPerCall(iterations, [&]() { sink += utilities::getValueList(LIST_INPUT).size(); }));
+
+    report("normalizePath",
+           nsPerCall(iterations, [&]() { std::string p = PATH_INPUT; sink += legacy::normalizePath(p).size(); }),
+           nsPerCall(iterations, [&]() { std::string p = PATH_INPUT; utilities::normalizePath(p); sink += p.size(); }));
+
+    return (sink != 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
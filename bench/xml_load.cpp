@@ -0,0 +1,167 @@
+/*
+ * Compares loading a .jucer the way project did before (read into a string, load_buffer with
+ * the default flags, which copies the text into a pugixml buffer) with the in place load of
+ * the memory mapped file that project uses now.
+ *
+ *   bench_xml_load [-n iterations] <.jucer>...
+ *
+ * Peak memory is the input buffer plus the peak of pugixml's heap (its text copy and nodes).
+ */
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <pugixml.hpp>
+
+#include "mappedfile.h"
+#include "utilities.h"
+
+namespace
+{
+    size_t liveBytes = 0;
+    size_t peakBytes = 0;
+
+    /* pugixml's deallocation gets no size, keep it in front of the block */
+    void* countingAllocate(size_t size)
+    {
+        char* p = static_cast<char*>(std::malloc(size + 16));
+        if (!p)
+        {
+            return nullptr;
+        }
+        memcpy(p, &size, sizeof(size));
+        liveBytes += size;
+        peakBytes = std::max(peakBytes, liveBytes);
+        return p + 16;
+    }
+
+    void countingDeallocate(void* ptr)
+    {
+        if (!ptr)
+        {
+            return;
+        }
+        char* p = static_cast<char*>(ptr) - 16;
+        size_t size;
+        memcpy(&size, p, sizeof(size));
+        liveBytes -= size;
+        std::free(p);
+    }
+
+    /* the flags of project::load */
+    const unsigned int inplaceFlags = pugi::parse_escapes | pugi::parse_wconv_attribute;
+
+    struct result
+    {
+        double ns;
+        size_t peakKB;
+        size_t nodes;
+    };
+
+    size_t countNodes(pugi::xml_node node)
+    {
+        size_t n = 1;
+        for (pugi::xml_node child : node.children())
+        {
+            n += countNodes(child);
+        }
+        return n;
+    }
+
+    template <typename F>
+    result measure(int iterations, F load)
+    {
+        result res = { 0, 0, 0 };
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            liveBytes = 0;
+            peakBytes = 0;
+            size_t input = load(res.nodes);
+            res.peakKB = (input + peakBytes) / 1024;
+        }
+        auto end = std::chrono::steady_clock::now();
+        res.ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+        return res;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int iterations = 200;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc)
+        {
+            iterations = std::atoi(argv[++i]);
+        }
+        else
+        {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty() || iterations <= 0)
+    {
+        std::cerr << "usage: bench_xml_load [-n iterations] <.jucer>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    pugi::set_memory_management_functions(countingAllocate, countingDeallocate);
+
+    std::cout << std::left << std::setw(30) << "file" << std::right << std::setw(10) << "KB" << std::setw(10) << "nodes"
+              << std::setw(14) << "copy us" << std::setw(14) << "inplace us" << std::setw(10) << "speedup"
+              << std::setw(14) << "copy peak KB" << std::setw(17) << "inplace peak KB" << "\n";
+    for (auto const& file : files)
+    {
+        size_t size = 0;
+        result copy = measure(iterations, [&](size_t& nodes)
+        {
+            std::string text;
+            if (!utilities::readFile(file, text))
+            {
+                return size_t(0);
+            }
+            pugi::xml_document doc;
+            doc.load_buffer(text.data(), text.size());
+            nodes = countNodes(doc);
+            size = text.size();
+            return text.size();
+        });
+        result inplace = measure(iterations, [&](size_t& nodes)
+        {
+            mappedFile map(file, true);
+            if (!map.isOpen())
+            {
+                return size_t(0);
+            }
+            pugi::xml_document doc;
+            doc.load_buffer_inplace(map.data(), map.size(), inplaceFlags);
+            nodes = countNodes(doc);
+            return map.size();
+        });
+
+        if (size == 0)
+        {
+            std::cerr << "Error opening file: " << file << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (copy.nodes != inplace.nodes)
+        {
+            std::cerr << "loads disagree on " << file << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::string name = file.substr(file.find_last_of('/') + 1);
+        std::cout << std::left << std::setw(30) << name << std::right << std::setw(10) << size / 1024 << std::setw(10) << copy.nodes
+                  << std::fixed << std::setprecision(1) << std::setw(14) << copy.ns / 1000 << std::setw(14) << inplace.ns / 1000
+                  << std::setw(9) << std::setprecision(2) << copy.ns / inplace.ns << "x"
+                  << std::setw(14) << copy.peakKB << std::setw(17) << inplace.peakKB << "\n";
+    }
+
+    return EXIT_SUCCESS;
+}
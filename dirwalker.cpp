@@ -0,0 +1,251 @@
+#include "dirwalker.h"
+
+#include <thread>
+#include <algorithm>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <cstring>
+
+#include "utilities.h"
+#include "profiler.h"
+
+
+dirWalker::dirWalker()
+{
+    // VCS metadata, build trees and package folders never contain modules
+    prune = { ".*", "build*", "Build*", "cmake-build*", "node_modules" };
+    maxDepth = 16;
+
+    // directory listing is latency bound (NFS), more threads than cores pays off
+    threads = std::max(4u, 2 * std::thread::hardware_concurrency());
+    pending = 0;
+    queued = 0;
+}
+
+void dirWalker::addPrune(std::string pattern)
+{
+    prune.push_back(pattern);
+}
+
+void dirWalker::clearPrune()
+{
+    prune.clear();
+}
+
+void dirWalker::setMaxDepth(int depth)
+{
+    maxDepth = depth;
+}
+
+void dirWalker::setThreads(unsigned int count)
+{
+    if (count != 0)
+    {
+        threads = count;
+    }
+}
+
+std::string dirWalker::getSettings() const
+{
+    std::string settings = std::to_string(maxDepth);
+    for (auto const& pattern : prune)
+    {
+        settings += " " + pattern;
+    }
+    return settings;
+}
+
+bool dirWalker::isPruned(const char* name) const
+{
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+    {
+        return true;
+    }
+    for (auto const& pattern : prune)
+    {
+        if (fnmatch(pattern.c_str(), name, 0) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void dirWalker::push(size_t self, dirWalker::directory dir)
+{
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(queues[self]->mutex);
+        queues[self]->items.push_back(dir);
+    }
+
+    // counted under idleMutex so that a worker cannot miss the wakeup between its check and wait
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        queued++;
+    }
+    idle.notify_one();
+}
+
+/* takes the newest item of its own queue (depth first), otherwise steals the oldest item of another queue */
+bool dirWalker::pop(size_t self, dirWalker::directory &dir)
+{
+    {
+        std::lock_guard<std::mutex> lock(queues[self]->mutex);
+        if (!queues[self]->items.empty())
+        {
+            dir = queues[self]->items.back();
+            queues[self]->items.pop_back();
+            queued--;
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < queues.size(); i++)
+    {
+        auto &victim = queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if (!victim->items.empty())
+        {
+            dir = victim->items.front();
+            victim->items.pop_front();
+            queued--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void dirWalker::list(size_t self, const dirWalker::directory &dir, const dirWalker::visitor &visit)
+{
+    bool isDirectory = false;
+    int64_t mtime = utilities::getModifiedTime(dir.path, &isDirectory);
+    if (mtime < 0 || !isDirectory)
+    {
+        return;
+    }
+
+    profiler::count(profiler::fsOpendir);
+    DIR *d = opendir(dir.path.c_str());
+    if (!d)
+    {
+        return;
+    }
+
+    std::vector<std::string> subdirs;
+    struct dirent *dp;
+    while ((dp = readdir(d)) != NULL)
+    {
+        if (isPruned(dp->d_name))
+        {
+            continue;
+        }
+
+        if (dp->d_type == DT_DIR)
+        {
+            subdirs.push_back(dp->d_name);
+        }
+        else if (dp->d_type == DT_UNKNOWN || dp->d_type == DT_LNK)
+        {
+            bool sub = false;
+            if (utilities::getModifiedTime(dir.path + "/" + dp->d_name, &sub) >= 0 && sub)
+            {
+                subdirs.push_back(dp->d_name);
+            }
+        }
+    }
+
+    closedir(d);
+
+    try
+    {
+        visit(dir, mtime, subdirs);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error)
+        {
+            error = std::current_exception();
+        }
+        return;
+    }
+
+    if (maxDepth >= 0 && dir.depth >= maxDepth)
+    {
+        return;
+    }
+
+    for (auto const& name : subdirs)
+    {
+        push(self, { dir.path + "/" + name, dir.depth + 1 });
+    }
+}
+
+void dirWalker::walk(const std::vector<dirWalker::directory> &start, dirWalker::visitor visit)
+{
+    if (start.empty())
+    {
+        return;
+    }
+
+    queues.clear();
+    for (unsigned int i = 0; i < threads; i++)
+    {
+        queues.emplace_back(new queue());
+    }
+
+    pending = 0;
+    queued = 0;
+    error = nullptr;
+    for (size_t i = 0; i < start.size(); i++)
+    {
+        push(i % queues.size(), start[i]);
+    }
+
+    auto worker = [&](size_t self)
+    {
+        directory dir;
+        while (true)
+        {
+            if (pop(self, dir))
+            {
+                list(self, dir, visit);
+                if (--pending == 0)
+                {
+                    std::lock_guard<std::mutex> lock(idleMutex);
+                    idle.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(idleMutex);
+            idle.wait(lock, [&] { return pending == 0 || queued > 0; });
+            if (pending == 0)
+            {
+                return;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < queues.size(); i++)
+    {
+        pool.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto &t : pool)
+    {
+        t.join();
+    }
+
+    queues.clear();
+
+    if (error)
+    {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <cstdint>
+
+class dirWalker
+{
+public:
+
+    struct directory
+    {
+        std::string path;
+        int depth;
+    };
+
+    /* called once per directory, subdirs holds the names to descend into and may be edited */
+    typedef std::function<void(const directory &dir, int64_t mtime, std::vector<std::string> &subdirs)> visitor;
+
+    dirWalker();
+
+    void addPrune(std::string pattern);
+    void clearPrune();
+    void setMaxDepth(int depth);
+    void setThreads(unsigned int count);
+    bool isPruned(const char* name) const;
+    /* the prune patterns and the depth limit, what a saved walk depends on */
+    std::string getSettings() const;
+
+    /* the first exception thrown by the visitor is rethrown once the walk has finished */
+    void walk(const std::vector<directory> &start, visitor visit);
+
+private:
+    struct queue
+    {
+        std::mutex mutex;
+        std::deque<directory> items;
+    };
+
+    void push(size_t self, directory dir);
+    bool pop(size_t self, directory &dir);
+    void list(size_t self, const directory &dir, const visitor &visit);
+
+    std::vector<std::string> prune;
+    int maxDepth;
+    unsigned int threads;
+
+    std::vector<std::unique_ptr<queue>> queues;
+    std::atomic<size_t> pending;
+    std::atomic<size_t> queued;
+
+    // idle workers sleep until an item is queued or nothing is pending
+    std::mutex idleMutex;
+    std::condition_variable idle;
+
+    std::mutex errorMutex;
+    std::exception_ptr error;
+};
@@ -0,0 +1,466 @@
+#include "embedder.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mappedfile.h"
+
+namespace
+{
+    /* "0," to "255," padded to four bytes, the length says how many of them are used */
+    struct literal
+    {
+        char text[4];
+        uint8_t length;
+    };
+
+    struct literalTable
+    {
+        literal entries[256];
+
+        literalTable()
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                char text[8];
+                int n = snprintf(text, sizeof(text), "%d,", i);
+                memset(entries[i].text, ' ', sizeof(entries[i].text));
+                memcpy(entries[i].text, text, n);
+                entries[i].length = static_cast<uint8_t>(n);
+            }
+        }
+    };
+
+    const literalTable table;
+}
+
+embedder::embedder()
+{
+    used = 0;
+    column = 0;
+    bytesIn = 0;
+    bytesOut = 0;
+}
+
+void embedder::add(std::string symbol, std::string path, bool compress)
+{
+    resources.push_back({ symbol, path, compress, false, 0, UINT64_MAX, 0, 0, 0 });
+}
+
+void embedder::addPart(std::string symbol, std::string path, uint64_t offset, uint64_t length, bool compress)
+{
+    resources.push_back({ symbol, path, compress, true, offset, length, 0, 0, 0 });
+}
+
+const std::vector<embedder::resource>& embedder::getResources()
+{
+    return resources;
+}
+
+uint64_t embedder::getBytesIn()
+{
+    return bytesIn;
+}
+
+uint64_t embedder::getBytesOut()
+{
+    return bytesOut;
+}
+
+void embedder::flush(int fd)
+{
+    size_t done = 0;
+    while (done < used)
+    {
+        ssize_t n = ::write(fd, buffer.data() + done, used - done);
+        if (n <= 0)
+        {
+            throw std::runtime_error("Error writing embedded resources");
+        }
+        done += n;
+    }
+    bytesOut += used;
+    used = 0;
+}
+
+void embedder::append(const char* text, size_t length)
+{
+    memcpy(buffer.data() + used, text, length);
+    used += length;
+}
+
+void embedder::append(const std::string& text)
+{
+    append(text.data(), text.length());
+}
+
+/*
+ * Every byte is a fixed four byte store from the table followed by an advance of its real
+ * length, there is no formatting and no branch per byte.  The buffer has room for a whole
+ * block, the caller flushes it in between.
+ */
+void embedder::encode(const unsigned char* data, size_t length)
+{
+    char* out = buffer.data() + used;
+    for (size_t i = 0; i < length; i++)
+    {
+        const literal& l = table.entries[data[i]];
+        memcpy(out, l.text, 4);
+        out += l.length;
+        if (++column == BYTES_PER_LINE)
+        {
+            *out++ = '\n';
+            column = 0;
+        }
+    }
+    used = out - buffer.data();
+}
+
+/*
+ * LZ4 block format: a token with the literal and match lengths (4 bits each, 15 continues in
+ * extra bytes of 255), the literals, a 16 bit offset.  The last 5 bytes are always literals
+ * and no match starts in the last 12, as the format requires.  Greedy, one hash probe per
+ * position, which is plenty for resources that are compressed once per build.
+ */
+std::vector<unsigned char> embedder::compress(const unsigned char* data, size_t length)
+{
+    std::vector<unsigned char> out;
+    out.reserve(length + length / 255 + 16);
+
+    auto putLength = [&out](size_t n)
+    {
+        for (; n >= 255; n -= 255)
+        {
+            out.push_back(255);
+        }
+        out.push_back(static_cast<unsigned char>(n));
+    };
+    auto read32 = [data](size_t i)
+    {
+        uint32_t v;
+        memcpy(&v, data + i, 4);
+        return v;
+    };
+
+    const int HASH_BITS = 14;
+    std::vector<uint32_t> table(1 << HASH_BITS, 0);
+
+    size_t anchor = 0;
+    size_t i = 0;
+    if (length > 12)
+    {
+        size_t matchLimit = length - 12;
+        size_t endLimit = length - 5;
+        while (i < matchLimit)
+        {
+            uint32_t seq = read32(i);
+            uint32_t h = (seq * 2654435761u) >> (32 - HASH_BITS);
+            size_t ref = table[h];
+            table[h] = static_cast<uint32_t>(i + 1);
+
+            if (ref == 0 || i - (ref - 1) > 65535 || read32(ref - 1) != seq)
+            {
+                i++;
+                continue;
+            }
+            ref--;
+
+            size_t matchLength = 4;
+            while (i + matchLength < endLimit && data[ref + matchLength] == data[i + matchLength])
+            {
+                matchLength++;
+            }
+
+            size_t literals = i - anchor;
+            size_t extra = matchLength - 4;
+            out.push_back(static_cast<unsigned char>(((literals < 15 ? literals : 15) << 4) | (extra < 15 ? extra : 15)));
+            if (literals >= 15)
+            {
+                putLength(literals - 15);
+            }
+            out.insert(out.end(), data + anchor, data + i);
+            size_t offset = i - ref;
+            out.push_back(static_cast<unsigned char>(offset & 0xff));
+            out.push_back(static_cast<unsigned char>(offset >> 8));
+            if (extra >= 15)
+            {
+                putLength(extra - 15);
+            }
+
+            i += matchLength;
+            anchor = i;
+        }
+    }
+
+    size_t literals = length - anchor;
+    out.push_back(static_cast<unsigned char>((literals < 15 ? literals : 15) << 4));
+    if (literals >= 15)
+    {
+        putLength(literals - 15);
+    }
+    out.insert(out.end(), data + anchor, data + length);
+    return out;
+}
+
+/* the same decoder as BinaryDataDecoder.h, used to verify and time every compressed resource */
+bool embedder::decompress(const unsigned char* data, size_t length, unsigned char* output, size_t outputLength)
+{
+    const unsigned char* ip = data;
+    const unsigned char* end = data + length;
+    unsigned char* op = output;
+    unsigned char* outputEnd = output + outputLength;
+
+    while (ip < end)
+    {
+        unsigned token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15)
+        {
+            unsigned char b;
+            do
+            {
+                if (ip == end)
+                {
+                    return false;
+                }
+                b = *ip++;
+                literals += b;
+            } while (b == 255);
+        }
+        if (literals > size_t(end - ip) || literals > size_t(outputEnd - op))
+        {
+            return false;
+        }
+        if (literals != 0)
+        {
+            memcpy(op, ip, literals);
+        }
+        op += literals;
+        ip += literals;
+        if (ip == end)
+        {
+            break;
+        }
+
+        if (end - ip < 2)
+        {
+            return false;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > size_t(op - output))
+        {
+            return false;
+        }
+        size_t matchLength = (token & 15) + 4;
+        if ((token & 15) == 15)
+        {
+            unsigned char b;
+            do
+            {
+                if (ip == end)
+                {
+                    return false;
+                }
+                b = *ip++;
+                matchLength += b;
+            } while (b == 255);
+        }
+        if (matchLength > size_t(outputEnd - op))
+        {
+            return false;
+        }
+        const unsigned char* match = op - offset;
+        while (matchLength--)
+        {
+            *op++ = *match++;
+        }
+    }
+    return op == outputEnd;
+}
+
+/*
+ * Compression needs the whole file, it is mapped rather than streamed.  The result is decoded
+ * again to check it and to measure the first access cost.  Data that does not get smaller is
+ * stored, the decoder recognizes it by the equal sizes and returns it without a copy.
+ */
+void embedder::writeCompressed(int fd, resource& r)
+{
+    mappedFile file(r.path);
+    if (!file.isOpen())
+    {
+        throw std::runtime_error("Error opening file: " + r.path);
+    }
+    auto input = reinterpret_cast<const unsigned char*>(file.data());
+    r.size = file.size();
+    if (r.part)
+    {
+        if (r.offset > r.size || (r.length != UINT64_MAX && r.length > r.size - r.offset))
+        {
+            throw std::runtime_error("Error reading file: " + r.path + " is shorter than when the project was generated");
+        }
+        input += r.offset;
+        r.size = (r.length == UINT64_MAX) ? r.size - r.offset : r.length;
+    }
+
+    std::vector<unsigned char> packed = compress(input, r.size);
+    if (packed.size() < r.size)
+    {
+        std::vector<unsigned char> check(r.size);
+        auto start = std::chrono::steady_clock::now();
+        bool ok = decompress(packed.data(), packed.size(), check.data(), check.size());
+        auto end = std::chrono::steady_clock::now();
+        if (!ok || memcmp(check.data(), input, r.size) != 0)
+        {
+            throw std::runtime_error("Error compressing file: " + r.path);
+        }
+        r.decodeMicroseconds = std::chrono::duration<double, std::micro>(end - start).count();
+        input = packed.data();
+        r.storedSize = packed.size();
+    }
+    else
+    {
+        r.storedSize = r.size;
+    }
+
+    append("    static const unsigned char " + r.symbol + "_data[] =\n    {\n");
+    column = 0;
+    for (size_t done = 0; done < r.storedSize; done += BLOCK_SIZE)
+    {
+        size_t n = r.storedSize - done < BLOCK_SIZE ? r.storedSize - done : BLOCK_SIZE;
+        encode(input + done, n);
+        flush(fd);
+    }
+    append("0\n    };\n\n");
+    if (r.part)
+    {
+        append("    extern const compressedPart " + r.symbol + ";\n");
+        append("    const compressedPart " + r.symbol + " = { " + r.symbol + "_data, "
+               + std::to_string(r.storedSize) + ", " + std::to_string(r.size) + " };\n\n");
+        flush(fd);
+        bytesIn += r.size;
+        return;
+    }
+    append("    extern const compressedResource " + r.symbol + ";\n");
+    append("    const compressedResource " + r.symbol + " (" + r.symbol + "_data, "
+           + std::to_string(r.storedSize) + ", " + std::to_string(r.size) + ");\n");
+    append("    extern const int " + r.symbol + "Size;\n");
+    append("    const int " + r.symbol + "Size = " + std::to_string(r.size) + ";\n\n");
+    flush(fd);
+
+    bytesIn += r.size;
+}
+
+void embedder::write(std::string output)
+{
+    // worst case per input block: four characters and a line break fraction per byte
+    buffer.resize(BLOCK_SIZE * 5 + 4096);
+    std::vector<unsigned char> block(BLOCK_SIZE);
+
+    std::string tmp = output + ".tmp" + std::to_string(getpid());
+    int out = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0)
+    {
+        throw std::runtime_error("Error writing file: " + output);
+    }
+
+    try
+    {
+        append(std::string("// generated by jucer2cmake --embed, do not edit\n\n"));
+        for (auto const& r : resources)
+        {
+            if (r.compress)
+            {
+                append(std::string("#include \"BinaryDataDecoder.h\"\n\n"));
+                break;
+            }
+        }
+        append(std::string("namespace BinaryData\n{\n"));
+
+        for (auto& r : resources)
+        {
+            if (r.compress)
+            {
+                writeCompressed(out, r);
+                continue;
+            }
+
+            int in = open(r.path.c_str(), O_RDONLY);
+            if (in < 0)
+            {
+                throw std::runtime_error("Error opening file: " + r.path);
+            }
+
+            if (r.part && lseek(in, r.offset, SEEK_SET) < 0)
+            {
+                close(in);
+                throw std::runtime_error("Error reading file: " + r.path);
+            }
+
+            // a part is an array of its own that the index refers to
+            if (r.part)
+            {
+                append("    extern const unsigned char " + r.symbol + "[];\n");
+                append("    const unsigned char " + r.symbol + "[] =\n    {\n");
+            }
+            else
+            {
+                append("    static const unsigned char " + r.symbol + "_data[] =\n    {\n");
+            }
+            column = 0;
+
+            uint64_t size = 0;
+            uint64_t remaining = r.length;
+            ssize_t n = 0;
+            while (remaining > 0 && (n = read(in, block.data(), std::min<uint64_t>(block.size(), remaining))) > 0)
+            {
+                encode(block.data(), n);
+                size += n;
+                remaining -= n;
+                flush(out);
+            }
+            close(in);
+            if (n < 0)
+            {
+                throw std::runtime_error("Error reading file: " + r.path);
+            }
+            if (r.part && r.length != UINT64_MAX && size != r.length)
+            {
+                throw std::runtime_error("Error reading file: " + r.path + " is shorter than when the project was generated");
+            }
+            bytesIn += size;
+            r.size = size;
+            r.storedSize = size;
+
+            append("0\n    };\n\n");
+            if (!r.part)
+            {
+                append("    extern const char* " + r.symbol + ";\n");
+                append("    const char* " + r.symbol + " = (const char*) " + r.symbol + "_data;\n");
+            }
+            append("    extern const int " + r.symbol + "Size;\n");
+            append("    const int " + r.symbol + "Size = " + std::to_string(size) + ";\n\n");
+            flush(out);
+        }
+
+        append(std::string("}\n"));
+        flush(out);
+    }
+    catch (...)
+    {
+        close(out);
+        std::remove(tmp.c_str());
+        throw;
+    }
+
+    if (close(out) != 0 || std::rename(tmp.c_str(), output.c_str()) != 0)
+    {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("Error writing file: " + output);
+    }
+}
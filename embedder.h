@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/*
+ * Writes resources as a BinaryData translation unit, each resource as an array literal with
+ * the JUCE style BinaryData::<symbol> and <symbol>Size definitions.  Inputs are streamed in
+ * fixed size blocks, so the memory used does not depend on the resource size.
+ *
+ * Compressed resources are LZ4 blocks, defined as BinaryData::compressedResource (see the
+ * BinaryDataDecoder.h written by the generator) which decompresses them on first use.
+ *
+ * A part is a byte range of a resource larger than a shard, defined as a plain array (or a
+ * compressedPart) and its size only; the BinaryData index joins the parts.
+ */
+class embedder
+{
+public:
+    struct resource
+    {
+        std::string symbol;
+        std::string path;
+        bool compress;
+        bool part;
+        uint64_t offset;
+        uint64_t length;
+        uint64_t size;
+        uint64_t storedSize;
+        double decodeMicroseconds;
+    };
+
+    embedder();
+
+    void add(std::string symbol, std::string path, bool compress = false);
+    /* length UINT64_MAX reads to the end of the file */
+    void addPart(std::string symbol, std::string path, uint64_t offset, uint64_t length, bool compress = false);
+    void write(std::string output);
+
+    const std::vector<resource>& getResources();
+    uint64_t getBytesIn();
+    uint64_t getBytesOut();
+
+    static std::vector<unsigned char> compress(const unsigned char* data, size_t length);
+    static bool decompress(const unsigned char* data, size_t length, unsigned char* output, size_t outputLength);
+
+private:
+    void writeCompressed(int fd, resource& r);
+
+    void flush(int fd);
+    void append(const char* text, size_t length);
+    void append(const std::string& text);
+    void encode(const unsigned char* data, size_t length);
+
+    std::vector<resource> resources;
+    std::vector<char> buffer;
+    size_t used;
+    size_t column;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t BYTES_PER_LINE = 32;
+};
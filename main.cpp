@@ -1,20 +1,210 @@
 #include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <cstdlib>
+#include <climits>
+#include <unistd.h>
 #include <sys/stat.h>
 
 #include "project.h"
+#include "batch.h"
+#include "moduleindex.h"
+#include "embedder.h"
+#include "watcher.h"
+#include "server.h"
+#include "profiler.h"
+#include "arena.h"
 
+/* the exit code of --check when an output would change, errors exit with EXIT_FAILURE */
+static const int EXIT_OUT_OF_DATE = 2;
+
+/*
+ * jucer2cmake --embed <output.cpp> [--compress] [--part=<offset>:[<length>]] <symbol>=<file>...,
+ * run by the generated projects.  --compress and --part apply to the resource that follows them,
+ * a part without a length reads to the end of the file.
+ */
+static int embed(const std::vector<std::string>& args)
+{
+    if (args.size() < 3)
+    {
+        std::cerr << "--embed requires an output file and <symbol>=<file> pairs" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    embedder e;
+    bool compress = false;
+    bool part = false;
+    uint64_t offset = 0;
+    uint64_t length = UINT64_MAX;
+    for (size_t i = 2; i < args.size(); i++)
+    {
+        if (args[i] == "--compress")
+        {
+            compress = true;
+            continue;
+        }
+        if (args[i].rfind("--part=", 0) == 0)
+        {
+            const char* range = args[i].c_str() + 7;
+            char* end = nullptr;
+            offset = std::strtoull(range, &end, 10);
+            if (end == range || *end != ':')
+            {
+                std::cerr << "--part expects <offset>:[<length>]: " << args[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+            range = end + 1;
+            length = (*range == 0) ? UINT64_MAX : std::strtoull(range, &end, 10);
+            if (*range != 0 && (end == range || *end != 0))
+            {
+                std::cerr << "--part expects <offset>:[<length>]: " << args[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+            part = true;
+            continue;
+        }
+        size_t eq = args[i].find('=');
+        if (eq == std::string::npos || eq == 0)
+        {
+            std::cerr << "--embed expects <symbol>=<file>: " << args[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (part)
+        {
+            e.addPart(args[i].substr(0, eq), args[i].substr(eq + 1), offset, length, compress);
+        }
+        else
+        {
+            e.add(args[i].substr(0, eq), args[i].substr(eq + 1), compress);
+        }
+        compress = false;
+        part = false;
+    }
+
+    try
+    {
+        e.write(args[1]);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // binary size of every resource and, for compressed ones, the cost of the first access
+    uint64_t stored = 0;
+    for (auto const& r : e.getResources())
+    {
+        stored += r.storedSize;
+        std::cout << std::left << std::setw(32) << r.symbol << std::right << std::setw(10) << r.size << " bytes";
+        if (r.compress && r.storedSize < r.size)
+        {
+            std::cout << " -> " << std::setw(10) << r.storedSize << " bytes ("
+                      << std::fixed << std::setprecision(1) << 100.0 * r.storedSize / r.size << "%), "
+                      << std::setprecision(0) << r.decodeMicroseconds << " us to decompress";
+        }
+        else if (r.compress)
+        {
+            std::cout << " stored, does not compress";
+        }
+        std::cout << "\n";
+    }
+    std::cout << std::left << std::setw(32) << "total" << std::right << std::setw(10) << e.getBytesIn() << " bytes -> "
+              << std::setw(10) << stored << " bytes in the binary" << std::endl;
+    return EXIT_SUCCESS;
+}
+
+/* jucer2cmake --connect <socket> <command> [arguments], paths are made absolute for the server */
+static int forward(const std::vector<std::string>& args)
+{
+    if (args.size() < 3)
+    {
+        std::cerr << "--connect requires a socket path and a command" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> request(args.begin() + 2, args.end());
+    for (size_t i = 1; i < request.size(); i++)
+    {
+        char path[PATH_MAX];
+        if (realpath(request[i].c_str(), path))
+        {
+            request[i] = path;
+        }
+        else if (request[i].rfind("/", 0) != 0 && getcwd(path, sizeof(path)))
+        {
+            request[i] = std::string(path) + "/" + request[i];
+        }
+    }
+
+    std::string reply;
+    bool ok = client(args[1]).request(request, reply);
+    (ok ? std::cout : std::cerr) << reply << std::flush;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* prints the --profile table and writes the --profile-trace file on every way out of main */
+class profileReport
+{
+public:
+    ~profileReport()
+    {
+        if (table)
+        {
+            profiler::printTable(std::cerr);
+            arena::printStatistics(std::cerr);
+        }
+        if (!trace.empty() && !profiler::writeTrace(trace))
+        {
+            std::cerr << "Error writing profile trace: " << trace << std::endl;
+        }
+    }
+
+    bool table = false;
+    std::string trace;
+};
 
 int main(int argc, char* argv[])
 {
     std::vector<std::string> args(argv + 1, argv + argc);
 
+    if (!args.empty() && args[0] == "--version")
+    {
+        std::cout << project::get_version() << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    if (!args.empty() && args[0] == "--embed")
+    {
+        return embed(args);
+    }
+
+    if (!args.empty() && args[0] == "--connect")
+    {
+        return forward(args);
+    }
+
     if (args.size() != 0)
     {
         bool verbose = false;
-        std::string inputpath = "";
+        bool check = false;
+        bool watch = false;
+        std::vector<std::string> inputpaths;
+        std::vector<std::string> listfiles;
+        std::vector<std::string> directories;
         std::string outputpath = "";
+        std::string socketpath = "";
+        unsigned int jobs = 0;
+        project::options opts;
+        profileReport profile;
 
-        int i = 0;
+        char self[PATH_MAX];
+        if (realpath("/proc/self/exe", self) || realpath(argv[0], self))
+        {
+            opts.generator = self;
+        }
+
+        size_t i = 0;
         while (i < args.size() && (args[i].rfind("-", 0) == 0))
         {
             std::string arg = args[i++];
@@ -22,11 +212,47 @@ int main(int argc, char* argv[])
             {
                 verbose = true;
             }
+            else if (arg == "--check")
+            {
+                check = true;
+            }
+            else if (arg == "--watch")
+            {
+                watch = true;
+            }
+            else if (arg == "--profile")
+            {
+                profile.table = true;
+                profiler::enable();
+            }
+            else if (arg == "--profile-trace")
+            {
+                if (i < args.size())
+                {
+                    profile.trace = args[i++];
+                    profiler::enable();
+                }
+                else
+                {
+                    std::cerr << "--profile-trace requires a file path" << std::endl;
+                }
+            }
+            else if (arg == "--serve")
+            {
+                if (i < args.size())
+                {
+                    socketpath = args[i++];
+                }
+                else
+                {
+                    std::cerr << "--serve requires a socket path" << std::endl;
+                }
+            }
             else if (arg == "-i")
             {
                 if (i < args.size())
                 {
-                    inputpath = args[i++];
+                    inputpaths.push_back(args[i++]);
                 }
                 else
                 {
@@ -38,33 +264,293 @@ int main(int argc, char* argv[])
                 if (i < args.size())
                 {
                     outputpath = args[i++];
-                    break;
                 }
                 else
                 {
                     std::cerr << "-o requires a path" << std::endl;
                 }
             }
+            else if (arg == "-l")
+            {
+                if (i < args.size())
+                {
+                    listfiles.push_back(args[i++]);
+                }
+                else
+                {
+                    std::cerr << "-l requires a file path" << std::endl;
+                }
+            }
+            else if (arg == "-r")
+            {
+                if (i < args.size())
+                {
+                    directories.push_back(args[i++]);
+                }
+                else
+                {
+                    std::cerr << "-r requires a directory path" << std::endl;
+                }
+            }
+            else if (arg == "--module-index")
+            {
+                if (i < args.size())
+                {
+                    moduleIndex::setFile(args[i++]);
+                }
+                else
+                {
+                    std::cerr << "--module-index requires a file path" << std::endl;
+                }
+            }
+            else if (arg == "--prune")
+            {
+                if (i < args.size())
+                {
+                    moduleIndex::getWalker().addPrune(args[i++]);
+                }
+                else
+                {
+                    std::cerr << "--prune requires a pattern" << std::endl;
+                }
+            }
+            else if (arg == "--max-depth")
+            {
+                if (i < args.size())
+                {
+                    moduleIndex::getWalker().setMaxDepth(std::atoi(args[i++].c_str()));
+                }
+                else
+                {
+                    std::cerr << "--max-depth requires a depth" << std::endl;
+                }
+            }
+            else if (arg == "-j")
+            {
+                char* end = nullptr;
+                long count = (i < args.size()) ? std::strtol(args[i].c_str(), &end, 10) : 0;
+                if (count <= 0 || count > INT_MAX || *end != 0)
+                {
+                    std::cerr << "-j requires a job count" << std::endl;
+                    return EXIT_FAILURE;
+                }
+                jobs = count;
+                i++;
+            }
+            else if (arg == "--unity")
+            {
+                opts.unity = true;
+            }
+            else if (arg == "--unity-batch-size")
+            {
+                if (i < args.size() && std::atoi(args[i].c_str()) > 0)
+                {
+                    opts.unityBatchSize = std::atoi(args[i++].c_str()) * 1024;
+                }
+                else
+                {
+                    std::cerr << "--unity-batch-size requires a size in KB" << std::endl;
+                }
+            }
+            else if (arg == "--unity-exclude")
+            {
+                if (i < args.size())
+                {
+                    opts.unityExclude.push_back(args[i++]);
+                }
+                else
+                {
+                    std::cerr << "--unity-exclude requires a pattern" << std::endl;
+                }
+            }
+            else if (arg == "--pch")
+            {
+                opts.precompiledHeader = true;
+            }
+            else if (arg == "--compiler-cache")
+            {
+                opts.compilerCache = true;
+            }
+            else if (arg == "--compress-resources")
+            {
+                opts.compressResources = true;
+            }
+            else if (arg == "--compress-exclude")
+            {
+                if (i < args.size())
+                {
+                    opts.compressExclude.push_back(args[i++]);
+                }
+                else
+                {
+                    std::cerr << "--compress-exclude requires a pattern" << std::endl;
+                }
+            }
+            else if (arg == "--ninja")
+            {
+                opts.ninja = true;
+            }
+            else if (arg == "--toolchain")
+            {
+                if (i < args.size())
+                {
+                    opts.toolchain = args[i++];
+                }
+                else
+                {
+                    std::cerr << "--toolchain requires a file path" << std::endl;
+                }
+            }
+            else if (arg == "--embed-shard-size")
+            {
+                if (i < args.size() && std::atoi(args[i].c_str()) > 0)
+                {
+                    opts.embedShardSize = std::atoi(args[i++].c_str()) * 1024;
+                }
+                else
+                {
+                    std::cerr << "--embed-shard-size requires a size in KB" << std::endl;
+                }
+            }
+            else
+            {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        // remaining arguments are .jucer files, glob patterns or directories
+        while (i < args.size())
+        {
+            inputpaths.push_back(args[i++]);
         }
 
-        if(!inputpath.empty())
+        if (!socketpath.empty())
         {
+            try
+            {
+                server s(socketpath);
+                s.setOptions(opts);
+                return s.run();
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << e.what() << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (watch && check)
+        {
+            std::cerr << "--watch cannot be used with --check" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (inputpaths.size() == 1 && listfiles.empty() && directories.empty())
+        {
+            std::string inputpath = inputpaths[0];
+
             struct stat info;
-            if( stat( inputpath.c_str(), &info ) == 0 )
+            bool exists = ( stat( inputpath.c_str(), &info ) == 0 );
+            if( exists && !S_ISDIR(info.st_mode) )
             {
                 std::cout << "Opening \"" << inputpath << "\"" << std::endl;
-                auto proj = project(inputpath.c_str(), outputpath);
-                proj.gen_cmake();
-                if(verbose)
+                try
                 {
-                    proj.print();
+                    profiler::scope s("convert", inputpath);
+                    project proj(inputpath, outputpath, opts);
+                    bool changed = proj.generate(check);
+                    if(verbose)
+                    {
+                        proj.print();
+                    }
+                    if(check)
+                    {
+                        std::cout << (changed ? "Out of date \"" : "Up to date \"") << proj.get_output_file() << "\"" << std::endl;
+                        return changed ? EXIT_OUT_OF_DATE : EXIT_SUCCESS;
+                    }
+                    std::cout << (changed ? "Created \"" : "Unchanged \"") << proj.get_output_file() << "\"" << std::endl;
                 }
-                std::cout << "Created \"" << proj.get_cmake_file() << "\"" << std::endl;
+                catch (const std::exception& e)
+                {
+                    std::cerr << e.what() << std::endl;
+                    if (!watch)
+                    {
+                        return EXIT_FAILURE;
+                    }
+                }
+                if (watch)
+                {
+                    watcher w;
+                    w.setOptions(opts);
+                    w.add(inputpath, outputpath);
+                    return w.run();
+                }
+                return EXIT_SUCCESS;
             }
-            else
+            else if( !exists && inputpath.find_first_of("*?[") == std::string::npos )
             {
                 std::cerr << "In-Valid file: " << inputpath << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (!inputpaths.empty() || !listfiles.empty() || !directories.empty())
+        {
+            if (!outputpath.empty())
+            {
+                std::cerr << "-o cannot be used with more than one project" << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            batch b;
+            b.setJobs(jobs);
+            b.setVerbose(verbose);
+            b.setCheck(check);
+            b.setOptions(opts);
+            try
+            {
+                for (auto const& path : listfiles)
+                {
+                    b.addListFile(path);
+                }
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << e.what() << std::endl;
+                return EXIT_FAILURE;
             }
+            for (auto const& path : directories)
+            {
+                b.addDirectory(path);
+            }
+            for (auto const& path : inputpaths)
+            {
+                b.addInput(path);
+            }
+
+            std::cout << "Converting " << b.size() << " projects" << std::endl;
+            int failures = b.run();
+            b.printSummary(std::cout);
+
+            if (watch)
+            {
+                watcher w;
+                w.setOptions(opts);
+                for (auto const& path : b.getInputs())
+                {
+                    w.add(path, "");
+                }
+                return w.run();
+            }
+
+            if (failures != 0)
+            {
+                return EXIT_FAILURE;
+            }
+            return (check && b.changed() != 0) ? EXIT_OUT_OF_DATE : EXIT_SUCCESS;
         }
     }
+
+    return EXIT_SUCCESS;
 }
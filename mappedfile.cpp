@@ -0,0 +1,87 @@
+#include "mappedfile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "profiler.h"
+
+
+mappedFile::mappedFile(const std::string& path, bool writable)
+{
+    address = nullptr;
+    length = 0;
+    valid = false;
+
+    profiler::count(profiler::fsOpen);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    struct stat info;
+    profiler::count(profiler::fsStat);
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+    {
+        length = info.st_size;
+        if (writable || length < MAP_THRESHOLD)
+        {
+            buffer.reset(new char[length + 1]);
+            size_t done = 0;
+            ssize_t n = 0;
+            while (done < length && (n = read(fd, buffer.get() + done, length - done)) > 0)
+            {
+                done += n;
+            }
+            length = done;
+            buffer[length] = 0;
+            valid = (n >= 0);
+        }
+        else
+        {
+            void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                address = p;
+                valid = true;
+            }
+        }
+    }
+
+    close(fd);
+}
+
+mappedFile::~mappedFile()
+{
+    if (address)
+    {
+        munmap(address, length);
+    }
+}
+
+bool mappedFile::isOpen() const
+{
+    return valid;
+}
+
+bool mappedFile::isMapped() const
+{
+    return address != nullptr;
+}
+
+const char* mappedFile::data() const
+{
+    return address ? static_cast<const char*>(address) : buffer.get();
+}
+
+char* mappedFile::data()
+{
+    return address ? static_cast<char*>(address) : buffer.get();
+}
+
+size_t mappedFile::size() const
+{
+    return length;
+}
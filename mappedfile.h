@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <cstddef>
+
+/*
+ * Whole file contents as one contiguous buffer.  Large files are memory mapped, small files
+ * are read with a single read() which is cheaper than setting up and tearing down a mapping.
+ * Writable buffers are always read: the caller changes most pages anyway, and a mapping of a
+ * file that is truncated meanwhile faults (SIGBUS) on the pages that were not copied yet.
+ */
+class mappedFile
+{
+public:
+    mappedFile(const std::string& path, bool writable = false);
+    ~mappedFile();
+
+    mappedFile(const mappedFile&) = delete;
+    mappedFile& operator=(const mappedFile&) = delete;
+
+    bool isOpen() const;
+    bool isMapped() const;
+    const char* data() const;
+    char* data();
+    size_t size() const;
+
+    static constexpr size_t MAP_THRESHOLD = 64 * 1024;
+
+private:
+    void* address;
+    std::unique_ptr<char[]> buffer;
+    size_t length;
+    bool valid;
+};
@@ -1,193 +1,187 @@
 #include "module.h"
 
 #include <iostream>
-#include <sstream>
-#include <istream>
-#include <fstream>
 #include <algorithm>
-#include <dirent.h>
-#include <cstring>
+#include <stdexcept>
+#include <string_view>
 
+#include "mappedfile.h"
+#include "moduleindex.h"
 #include "utilities.h"
 
 
-void module::listFilesRecursively(std::string basePath, std::string filename)
+std::mutex module::cacheMutex;
+std::map<std::string, module::cached> module::cache;
+
+module::module(std::string basePath, std::string module)
 {
-    DIR *dir = opendir(basePath.c_str());
-    if (!dir)
+    metaData = std::make_shared<map_t>();
+#if defined(DEBUG)
+    std::cout << "looking for module: " << module << std::endl;
+#endif
+    moduleIndex::entry e;
+    if(moduleIndex::instance().find(basePath, module, e))
     {
-        return;
+        module_header = e.header;
+        metaData = e.metaData;
+#if defined(DEBUG)
+        std::cout << module << " : metaData " << metaData->size() << std::endl;
+        std::cout << "dependencies length: " << getDependencies().length() << std::endl;
+#endif
     }
+}
 
-    std::string path;
-    struct dirent *dp;
-    while ((dp = readdir(dir)) != NULL)
-    {
-        if (strcmp(dp->d_name, ".") != 0 && strcmp(dp->d_name, "..") != 0)
-        {
-            if (strcmp(dp->d_name, filename.c_str()) == 0)
-            {
-                module_header = basePath + sepd + dp->d_name;
-                break;
-            }
-
-            // Construct new path from our base path
-            path = basePath + sepd + std::string(dp->d_name);
+module::module(std::string header)
+{
+    module_header = header;
+    std::string path = header;
+    utilities::normalizePath(path);
+    auto meta = std::make_shared<map_t>();
+    readMetaData(path, *meta);
+    metaData = meta;
+}
 
-            listFilesRecursively(path, filename);
-        }
-    }
+module::module(std::string header, std::shared_ptr<const map_t> meta)
+{
+    module_header = header;
+    metaData = meta ? meta : std::make_shared<map_t>();
+}
 
-    closedir(dir);
+std::string module::getHeader()
+{
+    return module_header;
 }
 
-module::module(std::string basePath, std::string module)
+const module::map_t& module::getMetaData() const
 {
-    base_path = basePath;
-    sepd = (base_path.find("\\") != std::string::npos) ? "\\" : "/";
+    return *metaData;
+}
 
-#if defined(DEBUG)
-    std::cout << "looking for module: " << module << std::endl;
-#endif
-    listFilesRecursively(basePath, module + ".h");
+std::shared_ptr<const module::map_t> module::getSharedMetaData() const
+{
+    return metaData;
+}
 
-    if(!module_header.empty())
-    {
-        getMetaData( utilities::normalizePath(module_header) );
-#if defined(DEBUG)
-        std::cout << module << " : metaData " << metaData.size() << std::endl;
-        std::cout << "dependencies length: " << metaData["dependencies"].length() << std::endl;
-#endif
-    }
+std::string module::getValue(const char *key) const
+{
+    auto it = metaData->find(key);
+    return (it != metaData->end()) ? it->second : std::string();
 }
 
 std::string module::getID()
 {
-    return metaData [ META_ID ];
+    return getValue(META_ID);
 }
 
 std::string module::getVendor()
 {
-    return metaData [ META_VENDOR ];
+    return getValue(META_VENDOR);
 }
 
 std::string module::getVersion()
 {
-    return metaData [ META_VERSION ];
+    return getValue(META_VERSION);
 }
 
 std::string module::getName()
 {
-    return metaData [ META_NAME ];
+    return getValue(META_NAME);
 }
 
 std::string module::getDescription()
 {
-    return metaData [ META_DESCRIPTION ];
+    return getValue(META_DESCRIPTION);
 }
 
 std::string module::getWebsite()
 {
-    return metaData[ META_WEBSITE ];
+    return getValue(META_WEBSITE);
 }
 
 std::string module::getLicense()
 {
-    return metaData [ META_LICENSE ];
+    return getValue(META_LICENSE);
 }
 
 std::string module::getDependencies()
 {
-    return metaData [ META_DEPENDENCIES ];
+    return getValue(META_DEPENDENCIES);
 }
 
 std::string module::getOSXFrameworks()
 {
-    return metaData [ META_OSX_FRAMEWORKS ];
+    return getValue(META_OSX_FRAMEWORKS);
 }
 
 std::string module::getiOSFrameworks()
 {
-    return metaData [ META_IOS_FRAMEWORKS ];
+    return getValue(META_IOS_FRAMEWORKS);
 }
 
 std::string module::getLinuxLibs()
 {
-    return metaData [ META_LINUX_LIBS ];
+    return getValue(META_LINUX_LIBS);
 }
 
 std::string module::getLinuxPackages()
 {
-    return metaData [ META_LINUX_PACKAGES ];
+    return getValue(META_LINUX_PACKAGES);
 }
 
 std::string module::getMingwLibs()
 {
-    return metaData [ META_MINGW_LIBS ];
+    return getValue(META_MINGW_LIBS);
 }
 
-void module::getMetaData(std::string inpfile)
+/*
+ * Scans the mapped header for the declaration block and parses its "key: value" lines
+ * in place.  Lines without a colon continue the previous value.  Scanning stops at
+ * END_JUCE_MODULE_DECLARATION, so the rest of the header is never paged in.
+ */
+void module::readMetaData(const std::string &inpfile, module::map_t &metaData)
 {
-    enum metadata_state
-    {
-        start = 0,
-        begin,
-        end
-    };
-
-    std::vector<std::string> tokens;
-    metadata_state state = start;
-    std::stringstream ss;
-    
-    std::ifstream is(inpfile);
-    if (!is)
+    mappedFile file(inpfile);
+    if (!file.isOpen())
         throw std::runtime_error("Error opening file: " + inpfile);
 
-    std::string line;
-    while (std::getline(is, line)) {
+    metaData.clear();
 
-        if(state == start)
-        {
-            if(line.find("BEGIN_JUCE_MODULE_DECLARATION") != std::string::npos)
-            {
-                state = begin;
-                continue;
-            }
-        }
-        else if(state == begin)
-        {
-            if(line.find("END_JUCE_MODULE_DECLARATION") != std::string::npos)
-            {
-                state = end;
-            }
-            else
-            {
-                ss << line << " \n";
-            }
-        }
+    std::string_view text(file.data(), file.size());
+    size_t pos = text.find(BEGIN_DECLARATION);
+    if (pos == std::string_view::npos)
+    {
+        return;
     }
+    pos = text.find('\n', pos);
 
-    metaData.clear();
-
-    std::string key;
-    auto lines = utilities::split(ss.str(),'\n');
-    for(auto &l : lines)
+    std::string* value = nullptr;
+    while (pos != std::string_view::npos)
     {
-        if(l.find(':') != std::string::npos)
+        size_t eol = text.find('\n', pos + 1);
+        std::string_view line = text.substr(pos + 1, (eol == std::string_view::npos) ? std::string_view::npos : eol - pos - 1);
+        pos = eol;
+
+        if (line.find(END_DECLARATION) != std::string_view::npos)
         {
-            auto kv = utilities::split(l, ':');
-            
-            std::string key = utilities::trim(kv[0]);
-            std::string value = utilities::trim(kv[1]);
+            break;
+        }
 
-            metaData[key] = value;
+        size_t colon = line.find(':');
+        if (colon != std::string_view::npos)
+        {
+            std::string_view key = utilities::trim(line.substr(0, colon));
+            value = &metaData[std::string(key)];
+            value->assign(utilities::trim(line.substr(colon + 1)));
         }
-        else
+        else if (value)
         {
-            if(l.length() > 2)
+            line = utilities::trim(line);
+            if (!line.empty())
             {
-                std::replace( l.begin(), l.end(), ',', ' ');
-                metaData[key] += " " + l;
+                value->push_back(' ');
+                size_t start = value->length();
+                value->append(line);
+                std::replace(value->begin() + start, value->end(), ',', ' ');
             }
         }
     }
@@ -196,9 +190,39 @@ void module::getMetaData(std::string inpfile)
 #endif
 }
 
+/* the header is parsed outside the lock, threads that miss at the same time parse it once each */
+std::shared_ptr<const module::map_t> module::getCached(const std::string &header, int64_t mtime)
+{
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = cache.find(header);
+        if (it != cache.end() && it->second.mtime == mtime)
+        {
+            return it->second.metaData;
+        }
+    }
+
+    auto meta = std::make_shared<map_t>();
+    readMetaData(header, *meta);
+    addCached(header, mtime, meta);
+    return meta;
+}
+
+void module::addCached(const std::string &header, int64_t mtime, std::shared_ptr<const module::map_t> meta)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cache[header] = { mtime, meta };
+}
+
+void module::clearCache()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cache.clear();
+}
+
 std::ostream& operator<<(std::ostream& os, const module& mod)
 {
-    auto m = mod.metaData;
+    auto m = *mod.metaData;
 
     os << "** Module **\n";
     os << "ID : " << m[ module::META_ID ] << "\n";
@@ -3,11 +3,22 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
 
 class module
 {
 public:
+    typedef std::map<std::string, std::string> map_t;
+
     module(std::string basePath, std::string module);
+    module(std::string header);
+    module(std::string header, std::shared_ptr<const map_t> meta);
+
+    std::string getHeader();
+    const map_t& getMetaData() const;
+    std::shared_ptr<const map_t> getSharedMetaData() const;
 
     std::string getID();
     std::string getVendor();
@@ -25,14 +36,28 @@ public:
 
     friend std::ostream& operator<<(std::ostream& os, const module& mod);
 
+    /*
+     * Process wide cache of parsed declarations, keyed by header path (below the real path of
+     * its search root) and mtime.  The declarations are shared by every project, not copied.
+     */
+    static std::shared_ptr<const map_t> getCached(const std::string &header, int64_t mtime);
+    static void addCached(const std::string &header, int64_t mtime, std::shared_ptr<const map_t> meta);
+    static void clearCache();
+
 private:
-    void getMetaData(std::string inpfile);
-    void listFilesRecursively(std::string basePath, std::string filename);
+    static void readMetaData(const std::string &inpfile, map_t &metaData);
+    std::string getValue(const char *key) const;
 
-    std::string base_path;
-    std::string sepd;
     std::string module_header;
-    std::map<std::string, std::string> metaData;
+    std::shared_ptr<const map_t> metaData;
+
+    struct cached
+    {
+        int64_t mtime;
+        std::shared_ptr<const map_t> metaData;
+    };
+    static std::mutex cacheMutex;
+    static std::map<std::string, cached> cache;
 
     static constexpr const char* META_ID = "ID";
     static constexpr const char* META_VENDOR = "vendor";
@@ -48,4 +73,7 @@ private:
     static constexpr const char* META_LINUX_PACKAGES = "linuxPackages";
     static constexpr const char* META_MINGW_LIBS = "mingwLibs";
     static constexpr const char* META_MINIMUM_CPP = "minimumCppStandard";
+
+    static constexpr const char* BEGIN_DECLARATION = "BEGIN_JUCE_MODULE_DECLARATION";
+    static constexpr const char* END_DECLARATION = "END_JUCE_MODULE_DECLARATION";
 };
@@ -0,0 +1,452 @@
+#include "moduleindex.h"
+
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <stdexcept>
+#include <algorithm>
+
+#include "module.h"
+#include "utilities.h"
+#include "profiler.h"
+
+
+std::string moduleIndex::file;
+
+moduleIndex::moduleIndex()
+{
+    loaded = false;
+    dirty = false;
+}
+
+moduleIndex& moduleIndex::instance()
+{
+    static moduleIndex index;
+    return index;
+}
+
+void moduleIndex::setFile(std::string path)
+{
+    file = path;
+}
+
+/* drops what is in memory, the next lookup starts from the index file again */
+void moduleIndex::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    roots.clear();
+    module::clearCache();
+    loaded = false;
+    dirty = false;
+}
+
+std::vector<std::string> moduleIndex::takeWarnings()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> taken;
+    taken.swap(warnings);
+    return taken;
+}
+
+std::string moduleIndex::getDefaultFile()
+{
+    std::string dir;
+    const char* cache = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (cache && *cache)
+    {
+        dir = cache;
+    }
+    else if (home && *home)
+    {
+        dir = std::string(home) + "/.cache";
+    }
+    else
+    {
+        return "";
+    }
+    return dir + "/jucer2cmake/modules.index";
+}
+
+/*
+ * Index file, one record per line:
+ *   W <max depth> <prune pattern>...
+ *   R <search root>
+ *   D <mtime> <directory>
+ *   M <module id> <mtime> <header>
+ *   K <key> <value>
+ */
+void moduleIndex::load()
+{
+    profiler::scope s("module index load");
+    loaded = true;
+    if (file.empty())
+    {
+        file = getDefaultFile();
+    }
+
+    std::string contents;
+    if (file.empty() || !utilities::readFile(file, contents))
+    {
+        return;
+    }
+
+    std::istringstream is(contents);
+    std::string line;
+    if (!std::getline(is, line) || line != INDEX_VERSION)
+    {
+        return;
+    }
+    // a walk with other settings finds other modules
+    if (!std::getline(is, line) || line != "W " + getWalker().getSettings())
+    {
+        return;
+    }
+
+    try
+    {
+        rootIndex *r = nullptr;
+        std::shared_ptr<module::map_t> meta;
+        while (std::getline(is, line))
+        {
+            if (line.length() < 3)
+            {
+                continue;
+            }
+            std::string rest = line.substr(2);
+            size_t sp = rest.find(' ');
+
+            if (line[0] == 'R')
+            {
+                r = &roots[rest];
+                meta.reset();
+            }
+            else if (r && line[0] == 'D' && sp != std::string::npos)
+            {
+                r->directories[rest.substr(sp + 1)] = std::stoll(rest.substr(0, sp));
+            }
+            else if (r && line[0] == 'M' && sp != std::string::npos)
+            {
+                size_t sp2 = rest.find(' ', sp + 1);
+                if (sp2 == std::string::npos)
+                {
+                    throw std::runtime_error("invalid module record");
+                }
+                entry &e = r->modules[rest.substr(0, sp)];
+                e.mtime = std::stoll(rest.substr(sp + 1, sp2 - sp - 1));
+                e.header = rest.substr(sp2 + 1);
+                meta = std::make_shared<module::map_t>();
+                e.metaData = meta;
+            }
+            else if (meta && line[0] == 'K')
+            {
+                (*meta)[rest.substr(0, sp)] = (sp == std::string::npos) ? "" : rest.substr(sp + 1);
+            }
+        }
+
+        // other roots holding the same headers share these declarations
+        for (auto const& root : roots)
+        {
+            for (auto const& m : root.second.modules)
+            {
+                module::addCached(m.second.header, m.second.mtime, m.second.metaData);
+            }
+        }
+    }
+    catch (const std::exception&)
+    {
+        warnings.push_back("Ignoring invalid module index: " + file);
+        roots.clear();
+    }
+}
+
+void moduleIndex::save()
+{
+    profiler::scope s("module index save");
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!dirty || file.empty())
+    {
+        return;
+    }
+
+    std::stringstream ss;
+    ss << INDEX_VERSION << "\n";
+    ss << "W " << getWalker().getSettings() << "\n";
+    for (auto const& r : roots)
+    {
+        ss << "R " << r.first << "\n";
+        for (auto const& d : r.second.directories)
+        {
+            ss << "D " << d.second << " " << d.first << "\n";
+        }
+        for (auto const& m : r.second.modules)
+        {
+            ss << "M " << m.first << " " << m.second.mtime << " " << m.second.header << "\n";
+            for (auto const& kv : *m.second.metaData)
+            {
+                ss << "K " << kv.first << " " << kv.second << "\n";
+            }
+        }
+    }
+
+    size_t sep = file.find_last_of('/');
+    if (sep != std::string::npos && sep != 0)
+    {
+        utilities::makeDirectories(file.substr(0, sep));
+    }
+    if (utilities::writeFileAtomic(file, ss.str()))
+    {
+        dirty = false;
+    }
+}
+
+dirWalker& moduleIndex::getWalker()
+{
+    static dirWalker walker;
+    return walker;
+}
+
+/* of two headers of the same module the one closest to the search root wins, then the first by path */
+static bool isPreferred(const std::string &header, const std::string &other)
+{
+    auto depth = std::count(header.begin(), header.end(), '/');
+    auto otherDepth = std::count(other.begin(), other.end(), '/');
+    return depth != otherDepth ? depth < otherDepth : header < other;
+}
+
+/*
+ * Walks the start directories in parallel, recording every directory and the module
+ * folders (<id>/<id>.h) found.  A module folder is not searched any further.  Without
+ * recursive only directories that are not in the index yet are descended into.  A module
+ * found in several folders is reported and the preferred one recorded, whatever order the
+ * walk finds them in.
+ */
+void moduleIndex::scan(moduleIndex::rootIndex &r, const std::vector<dirWalker::directory> &start, bool recursive)
+{
+    profiler::scope s("module walk");
+    std::mutex scanMutex;
+
+    getWalker().walk(start, [&](const dirWalker::directory &dir, int64_t mtime, std::vector<std::string> &subdirs)
+    {
+        std::vector<std::string> descend;
+        for (auto const& name : subdirs)
+        {
+            std::string path = dir.path + "/" + name;
+            std::string header = path + "/" + name + ".h";
+
+            int64_t headerTime = utilities::getModifiedTime(header);
+            if (headerTime >= 0)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(scanMutex);
+                    auto it = r.modules.find(name);
+                    if (it != r.modules.end() && it->second.header == header && it->second.mtime == headerTime)
+                    {
+                        continue;
+                    }
+                }
+
+                module m(header, module::getCached(header, headerTime));
+                if (!m.getID().empty())
+                {
+                    std::lock_guard<std::mutex> lock(scanMutex);
+                    auto it = r.modules.find(name);
+                    if (it != r.modules.end() && it->second.header != header && utilities::getModifiedTime(it->second.header) >= 0)
+                    {
+                        bool kept = isPreferred(it->second.header, header);
+                        std::string used = kept ? it->second.header : header;
+                        std::string ignored = kept ? header : it->second.header;
+                        warnings.push_back("Module " + name + " found in " + ignored + " and " + used + ", using " + used);
+                        if (kept)
+                        {
+                            continue;
+                        }
+                    }
+                    entry &e = r.modules[name];
+                    e.header = header;
+                    e.mtime = headerTime;
+                    e.metaData = m.getSharedMetaData();
+                    continue;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(scanMutex);
+            if (recursive || r.directories.find(path) == r.directories.end())
+            {
+                descend.push_back(name);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(scanMutex);
+        r.directories[dir.path] = mtime;
+        subdirs.swap(descend);
+    });
+}
+
+/* rescans the directories whose mtime changed, i.e. where entries were added or removed */
+void moduleIndex::refresh(moduleIndex::rootIndex &r, const std::string &root)
+{
+    profiler::scope s("module refresh");
+    std::vector<dirWalker::directory> changed;
+
+    auto directories = r.directories;
+    for (auto const& d : directories)
+    {
+        int64_t mtime = utilities::getModifiedTime(d.first);
+        if (mtime < 0)
+        {
+            r.directories.erase(d.first);
+            dirty = true;
+        }
+        else if (mtime != d.second)
+        {
+            int depth = std::count(d.first.begin() + root.length(), d.first.end(), '/');
+            changed.push_back({ d.first, depth });
+        }
+    }
+
+    if (!changed.empty())
+    {
+        scan(r, changed, false);
+        dirty = true;
+    }
+}
+
+/* validates an indexed module with a single stat of its header */
+bool moduleIndex::lookup(moduleIndex::rootIndex &r, const std::string &id, moduleIndex::entry &e)
+{
+    auto it = r.modules.find(id);
+    if (it == r.modules.end())
+    {
+        return false;
+    }
+
+    int64_t mtime = utilities::getModifiedTime(it->second.header);
+    if (mtime == it->second.mtime)
+    {
+        e = it->second;
+        return true;
+    }
+
+    dirty = true;
+    if (mtime >= 0)
+    {
+        it->second.mtime = mtime;
+        it->second.metaData = module::getCached(it->second.header, mtime);
+        e = it->second;
+        return true;
+    }
+
+    r.modules.erase(it);
+    return false;
+}
+
+/* the usual layouts, <root>/<id>/<id>.h and <root>/modules/<id>/<id>.h, are tried before walking */
+bool moduleIndex::lookupCanonical(moduleIndex::rootIndex &r, const std::string &root, const std::string &id, moduleIndex::entry &e)
+{
+    for (auto const& dir : { root + "/" + id, root + "/modules/" + id })
+    {
+        std::string header = dir + "/" + id + ".h";
+        int64_t mtime = utilities::getModifiedTime(header);
+        if (mtime < 0)
+        {
+            continue;
+        }
+
+        module m(header, module::getCached(header, mtime));
+        if (!m.getID().empty())
+        {
+            entry &n = r.modules[id];
+            n.header = header;
+            n.mtime = mtime;
+            n.metaData = m.getSharedMetaData();
+            e = n;
+            dirty = true;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Resolves all ids below root, found ids are moved from ids to found.  Only the ids that
+ * are neither indexed nor in a canonical location cost a (single, shared) directory walk.
+ */
+void moduleIndex::find(std::string root, std::vector<std::string> &ids, std::map<std::string, moduleIndex::entry> &found)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!loaded)
+    {
+        load();
+    }
+
+    char resolved[PATH_MAX];
+    if (realpath(root.c_str(), resolved) == NULL)
+    {
+        return;
+    }
+    std::string key = resolved;
+    rootIndex &r = roots[key];
+
+    std::vector<std::string> missing;
+    for (auto const& id : ids)
+    {
+        entry e;
+        if (lookup(r, id, e) || lookupCanonical(r, key, id, e))
+        {
+            found[id] = e;
+        }
+        else
+        {
+            missing.push_back(id);
+        }
+    }
+
+    if (!missing.empty())
+    {
+        if (r.directories.empty())
+        {
+            scan(r, { { key, 0 } }, true);
+            dirty = true;
+        }
+        else
+        {
+            refresh(r, key);
+        }
+
+        auto it = missing.begin();
+        while (it != missing.end())
+        {
+            entry e;
+            if (lookup(r, *it, e))
+            {
+                found[*it] = e;
+                it = missing.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    ids.swap(missing);
+}
+
+bool moduleIndex::find(std::string root, std::string id, moduleIndex::entry &e)
+{
+    std::vector<std::string> ids = { id };
+    std::map<std::string, entry> found;
+
+    find(root, ids, found);
+    if (found.empty())
+    {
+        return false;
+    }
+    e = found.begin()->second;
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+#include "dirwalker.h"
+#include "module.h"
+
+class moduleIndex
+{
+public:
+
+    struct entry
+    {
+        std::string header;
+        int64_t mtime;
+        std::shared_ptr<const module::map_t> metaData;
+    };
+
+    static moduleIndex& instance();
+    static void setFile(std::string path);
+    static std::string getDefaultFile();
+
+    static dirWalker& getWalker();
+
+    bool find(std::string root, std::string id, entry &e);
+    void find(std::string root, std::vector<std::string> &ids, std::map<std::string, entry> &found);
+    void save();
+    void reset();
+    /* problems met since the last call, for the caller to report */
+    std::vector<std::string> takeWarnings();
+
+private:
+    moduleIndex();
+
+    struct rootIndex
+    {
+        std::map<std::string, int64_t> directories;
+        std::map<std::string, entry> modules;
+    };
+
+    void load();
+    void scan(rootIndex &r, const std::vector<dirWalker::directory> &start, bool recursive);
+    void refresh(rootIndex &r, const std::string &root);
+    bool lookup(rootIndex &r, const std::string &id, entry &e);
+    bool lookupCanonical(rootIndex &r, const std::string &root, const std::string &id, entry &e);
+
+    std::map<std::string, rootIndex> roots;
+    std::vector<std::string> warnings;
+    std::mutex mutex;
+    bool loaded;
+    bool dirty;
+
+    static std::string file;
+
+    static constexpr const char* INDEX_VERSION = "jucer2cmake-module-index 2";
+};
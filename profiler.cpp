@@ -0,0 +1,304 @@
+#include "profiler.h"
+
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+
+std::atomic<bool> profiler::enabled(false);
+std::atomic<int64_t> profiler::counts[profiler::COUNTERS];
+std::atomic<int64_t> profiler::selfReads(0);
+std::atomic<int64_t> profiler::selfBytes(0);
+std::mutex profiler::mutex;
+std::vector<profiler::event> profiler::events;
+std::chrono::steady_clock::time_point profiler::origin;
+
+namespace
+{
+    std::atomic<int> nextThread(1);
+
+    int threadNumber()
+    {
+        thread_local int number = nextThread.fetch_add(1);
+        return number;
+    }
+
+    int64_t peakRss()
+    {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+        {
+            return 0;
+        }
+#if defined(__APPLE__)
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+
+    std::string escape(const std::string& s)
+    {
+        std::string res;
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+            {
+                res += '\\';
+                res += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", c);
+                res += code;
+            }
+            else
+            {
+                res += c;
+            }
+        }
+        return res;
+    }
+}
+
+void profiler::enable()
+{
+    origin = std::chrono::steady_clock::now();
+    enabled = true;
+}
+
+bool profiler::isEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+/*
+ * The /proc/self/io read of a snapshot is itself a read syscall, the reads and bytes of the
+ * snapshots are counted separately and taken out of the deltas.
+ */
+profiler::sample profiler::snapshot()
+{
+    sample s;
+    memset(&s, 0, sizeof(s));
+    for (int c = 0; c < COUNTERS; c++)
+    {
+        s.counts[c] = counts[c].load(std::memory_order_relaxed);
+    }
+    s.selfReads = selfReads.load(std::memory_order_relaxed);
+    s.selfBytes = selfBytes.load(std::memory_order_relaxed);
+
+    int fd = ::open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return s;
+    }
+    char buffer[512];
+    ssize_t n = ::read(fd, buffer, sizeof(buffer) - 1);
+    ::close(fd);
+    if (n <= 0)
+    {
+        return s;
+    }
+    selfReads.fetch_add(1, std::memory_order_relaxed);
+    selfBytes.fetch_add(n, std::memory_order_relaxed);
+    buffer[n] = 0;
+
+    for (char* line = buffer; line && *line; )
+    {
+        char* next = strchr(line, '\n');
+        int64_t value = 0;
+        const char* colon = strchr(line, ':');
+        if (colon)
+        {
+            value = strtoll(colon + 1, nullptr, 10);
+        }
+        if (strncmp(line, "rchar:", 6) == 0)
+        {
+            s.bytesRead = value;
+        }
+        else if (strncmp(line, "wchar:", 6) == 0)
+        {
+            s.bytesWritten = value;
+        }
+        else if (strncmp(line, "syscr:", 6) == 0)
+        {
+            s.readCalls = value;
+        }
+        else if (strncmp(line, "syscw:", 6) == 0)
+        {
+            s.writeCalls = value;
+        }
+        line = next ? next + 1 : nullptr;
+    }
+    return s;
+}
+
+void profiler::record(profiler::event e)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(std::move(e));
+}
+
+profiler::scope::scope(const char* n)
+{
+    name = n;
+    begin();
+}
+
+profiler::scope::scope(const char* n, const std::string& d)
+{
+    name = n;
+    if (profiler::isEnabled())
+    {
+        detail = d;
+    }
+    begin();
+}
+
+void profiler::scope::begin()
+{
+    active = profiler::isEnabled();
+    if (active)
+    {
+        first = profiler::snapshot();
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+profiler::scope::~scope()
+{
+    if (!active)
+    {
+        return;
+    }
+    auto end = std::chrono::steady_clock::now();
+    sample last = profiler::snapshot();
+
+    event e;
+    e.name = name;
+    e.detail = std::move(detail);
+    e.start = std::chrono::duration<double, std::micro>(start - profiler::origin).count();
+    e.duration = std::chrono::duration<double, std::micro>(end - start).count();
+    e.thread = threadNumber();
+    for (int c = 0; c < COUNTERS; c++)
+    {
+        e.delta.counts[c] = last.counts[c] - first.counts[c];
+    }
+    e.delta.readCalls = (last.readCalls - first.readCalls) - (last.selfReads - first.selfReads);
+    e.delta.bytesRead = (last.bytesRead - first.bytesRead) - (last.selfBytes - first.selfBytes);
+    e.delta.writeCalls = last.writeCalls - first.writeCalls;
+    e.delta.bytesWritten = last.bytesWritten - first.bytesWritten;
+    e.delta.selfReads = 0;
+    e.delta.selfBytes = 0;
+    e.peakRss = peakRss();
+    profiler::record(std::move(e));
+}
+
+/* one row per scope name in the order they first started, nested scopes are included in their parents */
+void profiler::printTable(std::ostream& os)
+{
+    std::vector<event> sorted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sorted = events;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const event& a, const event& b)
+    {
+        return a.start < b.start;
+    });
+
+    struct row
+    {
+        std::string name;
+        int calls;
+        double duration;
+        sample delta;
+        int64_t peakRss;
+    };
+    std::vector<row> rows;
+    std::map<std::string, size_t> index;
+    for (auto const& e : sorted)
+    {
+        auto it = index.find(e.name);
+        if (it == index.end())
+        {
+            it = index.emplace(e.name, rows.size()).first;
+            row r;
+            memset(&r.delta, 0, sizeof(r.delta));
+            r.name = e.name;
+            r.calls = 0;
+            r.duration = 0;
+            r.peakRss = 0;
+            rows.push_back(r);
+        }
+        row& r = rows[it->second];
+        r.calls++;
+        r.duration += e.duration;
+        for (int c = 0; c < COUNTERS; c++)
+        {
+            r.delta.counts[c] += e.delta.counts[c];
+        }
+        r.delta.readCalls += e.delta.readCalls;
+        r.delta.writeCalls += e.delta.writeCalls;
+        r.delta.bytesRead += e.delta.bytesRead;
+        r.delta.bytesWritten += e.delta.bytesWritten;
+        r.peakRss = std::max(r.peakRss, e.peakRss);
+    }
+
+    os << std::left << std::setw(22) << "phase" << std::right << std::setw(7) << "calls" << std::setw(11) << "ms"
+       << std::setw(8) << "stat" << std::setw(8) << "open" << std::setw(8) << "opendir"
+       << std::setw(8) << "reads" << std::setw(8) << "writes" << std::setw(11) << "KB read" << std::setw(11) << "KB written"
+       << std::setw(10) << "RSS MB" << "\n";
+    for (auto const& r : rows)
+    {
+        os << std::left << std::setw(22) << r.name << std::right << std::setw(7) << r.calls
+           << std::fixed << std::setprecision(3) << std::setw(11) << r.duration / 1000
+           << std::setw(8) << r.delta.counts[fsStat] << std::setw(8) << r.delta.counts[fsOpen] << std::setw(8) << r.delta.counts[fsOpendir]
+           << std::setw(8) << r.delta.readCalls << std::setw(8) << r.delta.writeCalls
+           << std::setprecision(1) << std::setw(11) << r.delta.bytesRead / 1024.0 << std::setw(11) << r.delta.bytesWritten / 1024.0
+           << std::setw(10) << r.peakRss / 1024.0 << "\n";
+    }
+    os << "peak RSS " << std::fixed << std::setprecision(1) << peakRss() / 1024.0 << " MB" << std::endl;
+}
+
+/* Chrome trace event format, complete ("X") events with the counters as arguments */
+bool profiler::writeTrace(const std::string& path)
+{
+    std::vector<event> copy;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        copy = events;
+    }
+
+    std::stringstream ss;
+    int pid = getpid();
+    ss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    ss << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"args\":{\"name\":\"jucer2cmake\"}}";
+    ss << std::fixed << std::setprecision(3);
+    for (auto const& e : copy)
+    {
+        ss << ",\n{\"name\":\"" << escape(e.name) << "\",\"cat\":\"jucer2cmake\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << e.thread
+           << ",\"ts\":" << e.start << ",\"dur\":" << e.duration << ",\"args\":{";
+        if (!e.detail.empty())
+        {
+            ss << "\"detail\":\"" << escape(e.detail) << "\",";
+        }
+        ss << "\"stat\":" << e.delta.counts[fsStat] << ",\"open\":" << e.delta.counts[fsOpen] << ",\"opendir\":" << e.delta.counts[fsOpendir]
+           << ",\"reads\":" << e.delta.readCalls << ",\"writes\":" << e.delta.writeCalls
+           << ",\"bytes_read\":" << e.delta.bytesRead << ",\"bytes_written\":" << e.delta.bytesWritten
+           << ",\"peak_rss_kb\":" << e.peakRss << "}}";
+    }
+    ss << "\n]}\n";
+
+    std::ofstream os(path, std::ofstream::binary | std::ofstream::trunc);
+    os << ss.str();
+    return static_cast<bool>(os);
+}
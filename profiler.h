@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+/*
+ * Phase timers for --profile.  While profiling is off a scope costs the test of one flag.  When
+ * it is on, every scope records its wall time, the filesystem calls counted with count(), the
+ * read and write syscalls and bytes of the process (/proc/self/io) and the peak RSS at its end.
+ * The counters are process wide, so scopes on other threads show up in each other's numbers.
+ */
+class profiler
+{
+public:
+    enum counter
+    {
+        fsStat,
+        fsOpen,
+        fsOpendir,
+        COUNTERS
+    };
+
+    struct sample
+    {
+        int64_t counts[COUNTERS];
+        int64_t readCalls;
+        int64_t writeCalls;
+        int64_t bytesRead;
+        int64_t bytesWritten;
+        int64_t selfReads;
+        int64_t selfBytes;
+    };
+
+    class scope
+    {
+    public:
+        scope(const char* name);
+        scope(const char* name, const std::string& detail);
+        ~scope();
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+
+    private:
+        void begin();
+
+        bool active;
+        const char* name;
+        std::string detail;
+        std::chrono::steady_clock::time_point start;
+        sample first;
+    };
+
+    static void enable();
+    static bool isEnabled();
+
+    static void count(counter c)
+    {
+        if (enabled.load(std::memory_order_relaxed))
+        {
+            counts[c].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static void printTable(std::ostream& os);
+    static bool writeTrace(const std::string& path);
+
+private:
+    struct event
+    {
+        const char* name;
+        std::string detail;
+        double start;
+        double duration;
+        int thread;
+        sample delta;
+        int64_t peakRss;
+    };
+
+    static sample snapshot();
+    static void record(event e);
+
+    static std::atomic<bool> enabled;
+    static std::atomic<int64_t> counts[COUNTERS];
+    static std::atomic<int64_t> selfReads;
+    static std::atomic<int64_t> selfBytes;
+    static std::mutex mutex;
+    static std::vector<event> events;
+    static std::chrono::steady_clock::time_point origin;
+};
@@ -4,50 +4,654 @@
 #include <iomanip>
 #include <sstream>
 #include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <set>
+#include <cstdio>
+#include <climits>
+#include <cstdlib>
 #include <sys/stat.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include "moduleindex.h"
+#include "mappedfile.h"
+#include "arena.h"
+#include "profiler.h"
 #include "utilities.h"
 
+#ifndef J2C_VERSION
+#define J2C_VERSION "1.0.0"
+#endif
+
+project::options::options()
+{
+    unity = false;
+    unityBatchSize = 512 * 1024;
+    precompiledHeader = false;
+    compilerCache = false;
+    embedShardSize = 1024 * 1024;
+    compressResources = false;
+    // formats that are compressed already
+    compressExclude = { "*.png", "*.jpg", "*.jpeg", "*.gif", "*.webp", "*.ogg", "*.mp3", "*.flac", "*.m4a", "*.zip", "*.gz" };
+    ninja = false;
+}
+
+/* the CMake fallback of --embed: cmake -P embed.cmake -- <output> [--compress] [--part=<offset>:[<length>]] <symbol>=<file>... */
+static const char* EMBED_SCRIPT = R"cmake(math(EXPR last "${CMAKE_ARGC} - 1")
+foreach(i RANGE ${last})
+    if(NOT DEFINED first AND "${CMAKE_ARGV${i}}" STREQUAL "--")
+        math(EXPR output "${i} + 1")
+        math(EXPR first "${i} + 2")
+    endif()
+    if("${CMAKE_ARGV${i}}" STREQUAL "--compress")
+        set(decoder "#include \"BinaryDataDecoder.h\"\n\n")
+    endif()
+endforeach()
+set(OUTPUT "${CMAKE_ARGV${output}}")
+file(WRITE "${OUTPUT}.tmp" "${decoder}namespace BinaryData\n{\n")
+set(compress OFF)
+set(part OFF)
+foreach(i RANGE ${first} ${last})
+    if("${CMAKE_ARGV${i}}" STREQUAL "--compress")
+        set(compress ON)
+        continue()
+    endif()
+    if("${CMAKE_ARGV${i}}" MATCHES "^--part=([0-9]+):([0-9]*)$")
+        set(part ON)
+        set(range OFFSET ${CMAKE_MATCH_1})
+        set(limit "${CMAKE_MATCH_2}")
+        if(NOT "${limit}" STREQUAL "")
+            list(APPEND range LIMIT ${limit})
+        endif()
+        continue()
+    endif()
+    string(FIND "${CMAKE_ARGV${i}}" "=" eq)
+    string(SUBSTRING "${CMAKE_ARGV${i}}" 0 ${eq} NAME)
+    math(EXPR eq "${eq} + 1")
+    string(SUBSTRING "${CMAKE_ARGV${i}}" ${eq} -1 INPUT)
+    if(part)
+        file(READ "${INPUT}" data ${range} HEX)
+    else()
+        file(READ "${INPUT}" data HEX)
+    endif()
+    string(LENGTH "${data}" length)
+    math(EXPR size "${length} / 2")
+    if(part AND NOT "${limit}" STREQUAL "" AND NOT size EQUAL limit)
+        message(FATAL_ERROR "${INPUT} is shorter than when the project was generated")
+    endif()
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," data "${data}")
+    if(part AND NOT compress)
+        # joined by the index
+        file(APPEND "${OUTPUT}.tmp"
+            "    extern const unsigned char ${NAME}[];\n"
+            "    const unsigned char ${NAME}[] = { ${data}0 };\n")
+    else()
+        file(APPEND "${OUTPUT}.tmp" "    static const unsigned char ${NAME}_data[] = { ${data}0 };\n")
+    endif()
+    if(part AND compress)
+        # stored as is, the decoder copies parts of equal sizes
+        file(APPEND "${OUTPUT}.tmp"
+            "    extern const compressedPart ${NAME};\n"
+            "    const compressedPart ${NAME} = { ${NAME}_data, ${size}, ${size} };\n\n")
+    else()
+        if(compress)
+            # stored as is, the decoder returns data of equal sizes without a copy
+            file(APPEND "${OUTPUT}.tmp"
+                "    extern const compressedResource ${NAME};\n"
+                "    const compressedResource ${NAME} (${NAME}_data, ${size}, ${size});\n")
+        elseif(NOT part)
+            file(APPEND "${OUTPUT}.tmp"
+                "    extern const char* ${NAME};\n"
+                "    const char* ${NAME} = (const char*) ${NAME}_data;\n")
+        endif()
+        file(APPEND "${OUTPUT}.tmp"
+            "    extern const int ${NAME}Size;\n"
+            "    const int ${NAME}Size = ${size};\n\n")
+    endif()
+    set(compress OFF)
+    set(part OFF)
+endforeach()
+file(APPEND "${OUTPUT}.tmp" "}\n")
+file(RENAME "${OUTPUT}.tmp" "${OUTPUT}")
+)cmake";
+
+/* the runtime side of compressed resources, written next to BinaryData.h */
+static const char* DECODER_HEADER = R"cpp(#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+namespace BinaryData
+{
+    /* LZ4 block decoder, returns false on malformed input */
+    inline bool decompress (const unsigned char* data, size_t length, unsigned char* output, size_t outputLength)
+    {
+        const unsigned char* ip = data;
+        const unsigned char* end = data + length;
+        unsigned char* op = output;
+        unsigned char* outputEnd = output + outputLength;
+
+        while (ip < end)
+        {
+            unsigned token = *ip++;
+            size_t literals = token >> 4;
+            if (literals == 15)
+            {
+                unsigned char b;
+                do
+                {
+                    if (ip == end)
+                        return false;
+                    b = *ip++;
+                    literals += b;
+                } while (b == 255);
+            }
+            if (literals > size_t (end - ip) || literals > size_t (outputEnd - op))
+                return false;
+            if (literals != 0)
+                std::memcpy (op, ip, literals);
+            op += literals;
+            ip += literals;
+            if (ip == end)
+                break;
+
+            if (end - ip < 2)
+                return false;
+            size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            if (offset == 0 || offset > size_t (op - output))
+                return false;
+            size_t matchLength = (token & 15) + 4;
+            if ((token & 15) == 15)
+            {
+                unsigned char b;
+                do
+                {
+                    if (ip == end)
+                        return false;
+                    b = *ip++;
+                    matchLength += b;
+                } while (b == 255);
+            }
+            if (matchLength > size_t (outputEnd - op))
+                return false;
+            const unsigned char* match = op - offset;
+            while (matchLength--)
+                *op++ = *match++;
+        }
+        return op == outputEnd;
+    }
+
+    /* one part of a resource larger than a shard, compressed on its own */
+    struct compressedPart
+    {
+        const unsigned char* data;
+        int size;
+        int originalSize;
+    };
+
+    /*
+     * A compressed resource, decompressed on first use and kept for the life of the program.
+     * Converts to const char* like the uncompressed BinaryData entries, the data is followed
+     * by a 0 byte.  Data that did not compress is used in place.  A resource made of parts
+     * is decompressed part by part into one block.
+     */
+    class compressedResource
+    {
+    public:
+        constexpr compressedResource (const unsigned char* d, int s, int o)
+            : data (d), size (s), originalSize (o), parts (nullptr), partCount (0) {}
+
+        constexpr compressedResource (const compressedPart* const* p, int n)
+            : data (nullptr), size (0), originalSize (0), parts (p), partCount (n) {}
+
+        const char* get() const
+        {
+            if (parts == nullptr && size == originalSize)
+                return reinterpret_cast<const char*> (data);
+
+            std::call_once (once, [this]
+            {
+                int length = originalSize;
+                for (int i = 0; i < partCount; ++i)
+                    length += parts[i]->originalSize;
+
+                std::unique_ptr<char[]> buffer (new char[length + 1]);
+                auto output = reinterpret_cast<unsigned char*> (buffer.get());
+                bool ok = true;
+                if (parts == nullptr)
+                    ok = decompress (data, size, output, originalSize);
+
+                for (int i = 0; i < partCount && ok; ++i)
+                {
+                    const compressedPart& p = *parts[i];
+                    if (p.size == p.originalSize)
+                        std::memcpy (output, p.data, size_t (p.size));
+                    else
+                        ok = decompress (p.data, size_t (p.size), output, size_t (p.originalSize));
+                    output += p.originalSize;
+                }
+
+                if (ok)
+                {
+                    buffer[length] = 0;
+                    cache = std::move (buffer);
+                }
+            });
+            return cache.get();
+        }
+
+        operator const char*() const { return get(); }
+
+    private:
+        const unsigned char* data;
+        int size;
+        int originalSize;
+        const compressedPart* const* parts;
+        int partCount;
+        mutable std::once_flag once;
+        mutable std::unique_ptr<char[]> cache;
+    };
+}
+)cpp";
+
 project::project()
 {
     version = "1.0.0";
     pluginAAXCategory = -1;
     downloadJuceSource = false;
+    modulesResolved = false;
+    jucer_hash = 0;
+    report = print_diagnostic;
+}
+
+/* BinaryData variable names as JUCE makes them: logo.png becomes logo_png, clashes get a number */
+std::vector<std::string> project::get_resource_symbols(const std::vector<std::string> &resources)
+{
+    std::vector<std::string> symbols;
+    for (auto const& file : resources)
+    {
+        std::string symbol = file.substr(file.find_last_of("\\/") + 1);
+        for (auto &c : symbol)
+        {
+            if (!isalnum(static_cast<unsigned char>(c)))
+            {
+                c = '_';
+            }
+        }
+        if (symbol.empty() || isdigit(static_cast<unsigned char>(symbol[0])))
+        {
+            symbol = "_" + symbol;
+        }
+
+        std::string unique = symbol;
+        for (int n = 2; std::find(symbols.begin(), symbols.end(), unique) != symbols.end(); n++)
+        {
+            unique = symbol + std::to_string(n);
+        }
+        symbols.push_back(unique);
+    }
+    return symbols;
+}
+
+/*
+ * The resources of the .jucer Resources groups, their symbols and shards, and the BinaryData.h
+ * and index sources, shared by the CMake and Ninja output.  Resources are filled into shards in
+ * project order.  A file larger than a shard is split into parts of a shard each (the last one
+ * reads to the end of the file), which the index joins: plain resources when the program
+ * starts, compressed ones when they are first used.
+ */
+void project::get_resource_data(project::resourceData &data)
+{
+    auto &resources = data.files;
+    for (auto const& group : mainGroup.groups)
+    {
+        if (group.name != "Resources")
+        {
+            continue;
+        }
+        for (auto const& index : group.files)
+        {
+            resources.push_back(files[index].file);
+        }
+    }
+
+    if (resources.empty())
+    {
+        return;
+    }
+
+    auto &symbols = data.symbols;
+    symbols = get_resource_symbols(resources);
+
+    auto &compressed = data.compressed;
+    compressed.assign(resources.size(), false);
+    if (opts.compressResources)
+    {
+        for (size_t i = 0; i < resources.size(); i++)
+        {
+            compressed[i] = std::none_of(opts.compressExclude.begin(), opts.compressExclude.end(), [&](const std::string &pattern)
+            {
+                return fnmatch(pattern.c_str(), resources[i].c_str(), FNM_CASEFOLD) == 0;
+            });
+        }
+    }
+
+    // JuceHeader.h includes the BinaryData.h next to it before any on the include path, whose
+    // const char* declarations would read the compressed resources as pointers
+    struct stat info;
+    std::string projucerHeader = base_path + sepd + "JuceLibraryCode" + sepd + "BinaryData.h";
+    profiler::count(profiler::fsStat);
+    if (std::find(compressed.begin(), compressed.end(), true) != compressed.end() && stat(projucerHeader.c_str(), &info) == 0)
+    {
+        report({ diagnostic::error, "Compressed resources conflict with " + projucerHeader + ", remove it (and BinaryData.cpp) or build without --compress-resources", jucer_file, 0, -1 });
+        throw std::runtime_error("Compressed resources cannot be used with " + projucerHeader);
+    }
+
+    auto &parts = data.parts;
+    std::vector<uint64_t> sizes;
+    for (auto const& file : resources)
+    {
+        struct stat info;
+        std::string path = base_path + sepd + file;
+        profiler::count(profiler::fsStat);
+        uint64_t size = (stat(path.c_str(), &info) == 0) ? info.st_size : 0;
+        sizes.push_back(size);
+        parts.emplace_back();
+        if (size > opts.embedShardSize)
+        {
+            for (uint64_t offset = 0; offset < size; offset += opts.embedShardSize)
+            {
+                parts.back().push_back(std::min<uint64_t>(opts.embedShardSize, size - offset));
+            }
+        }
+    }
+
+    std::stringstream header;
+    header << "#pragma once\n\n";
+    if (opts.compressResources)
+    {
+        header << "#include \"BinaryDataDecoder.h\"\n\n";
+    }
+    header << "namespace BinaryData\n{\n";
+    for (size_t i = 0; i < symbols.size(); i++)
+    {
+        header << "    extern const " << (compressed[i] ? "compressedResource " : "char* ") << symbols[i] << ";\n";
+        header << "    extern const int " << symbols[i] << "Size;\n\n";
+    }
+    header << "    const int namedResourceListSize = " << symbols.size() << ";\n";
+    header << "    extern const char* namedResourceList[];\n";
+    header << "    extern const char* originalFilenames[];\n";
+    header << "    const char* getNamedResource (const char* resourceNameUTF8, int& dataSizeInBytes);\n";
+    header << "    const char* getNamedResourceOriginalFilename (const char* resourceNameUTF8);\n";
+    header << "}\n";
+
+    std::stringstream index;
+    index << "#include <cstring>\n";
+    index << "#include \"BinaryData.h\"\n\n";
+    index << "namespace BinaryData\n{\n";
+    for (size_t i = 0; i < resources.size(); i++)
+    {
+        if (!parts[i].empty() && !compressed[i])
+        {
+            index << "    // resources larger than a shard are embedded in parts, joined when the program starts\n";
+            index << "    static const char* joinParts (const unsigned char* const* parts, const int* const* sizes, int count, int size)\n";
+            index << "    {\n";
+            index << "        char* data = new char[size + 1];\n";
+            index << "        int offset = 0;\n";
+            index << "        for (int i = 0; i < count; ++i)\n";
+            index << "        {\n";
+            index << "            std::memcpy (data + offset, parts[i], (size_t) *sizes[i]);\n";
+            index << "            offset += *sizes[i];\n";
+            index << "        }\n";
+            index << "        data[size] = 0;\n";
+            index << "        return data;\n";
+            index << "    }\n\n";
+            break;
+        }
+    }
+    for (size_t i = 0; i < resources.size(); i++)
+    {
+        if (parts[i].empty())
+        {
+            continue;
+        }
+        auto const& symbol = symbols[i];
+        std::string list;
+        std::string sizeList;
+        std::string total;
+        for (size_t k = 1; k <= parts[i].size(); k++)
+        {
+            std::string part = symbol + "_part" + std::to_string(k);
+            std::string separator = (k == 1) ? "" : ", ";
+            if (compressed[i])
+            {
+                index << "    extern const compressedPart " << part << ";\n";
+                list += separator + "&" + part;
+                total += (k == 1 ? "" : " + ") + part + ".originalSize";
+            }
+            else
+            {
+                index << "    extern const unsigned char " << part << "[];\n";
+                index << "    extern const int " << part << "Size;\n";
+                list += separator + part;
+                sizeList += separator + "&" + part + "Size";
+                total += (k == 1 ? "" : " + ") + part + "Size";
+            }
+        }
+        if (compressed[i])
+        {
+            index << "    static const compressedPart* const " << symbol << "_parts[] = { " << list << " };\n";
+            index << "    const int " << symbol << "Size = " << total << ";\n";
+            index << "    const compressedResource " << symbol << " (" << symbol << "_parts, " << parts[i].size() << ");\n\n";
+        }
+        else
+        {
+            index << "    static const unsigned char* const " << symbol << "_parts[] = { " << list << " };\n";
+            index << "    static const int* const " << symbol << "_partSizes[] = { " << sizeList << " };\n";
+            index << "    const int " << symbol << "Size = " << total << ";\n";
+            index << "    const char* " << symbol << " = joinParts (" << symbol << "_parts, " << symbol << "_partSizes, " << parts[i].size() << ", " << symbol << "Size);\n\n";
+        }
+    }
+    index << "    const char* namedResourceList[] =\n    {\n";
+    for (auto const& symbol : symbols)
+    {
+        index << "        \"" << symbol << "\",\n";
+    }
+    index << "    };\n\n";
+    index << "    const char* originalFilenames[] =\n    {\n";
+    for (auto const& file : resources)
+    {
+        index << "        \"" << file.substr(file.find_last_of("\\/") + 1) << "\",\n";
+    }
+    index << "    };\n\n";
+    // accessors, so that compressed resources are only decompressed when they are asked for
+    index << "    static const char* (*const resourceData[])() =\n    {\n";
+    for (auto const& symbol : symbols)
+    {
+        index << "        [] () -> const char* { return " << symbol << "; },\n";
+    }
+    index << "    };\n";
+    index << "    static const int* resourceSizes[] = { ";
+    for (auto const& symbol : symbols)
+    {
+        index << "&" << symbol << "Size, ";
+    }
+    index << "};\n\n";
+    index << "    const char* getNamedResource (const char* resourceNameUTF8, int& numBytes)\n";
+    index << "    {\n";
+    index << "        for (int i = 0; i < namedResourceListSize; ++i)\n";
+    index << "        {\n";
+    index << "            if (std::strcmp (namedResourceList[i], resourceNameUTF8) == 0)\n";
+    index << "            {\n";
+    index << "                numBytes = *resourceSizes[i];\n";
+    index << "                return resourceData[i]();\n";
+    index << "            }\n";
+    index << "        }\n";
+    index << "        numBytes = 0;\n";
+    index << "        return nullptr;\n";
+    index << "    }\n\n";
+    index << "    const char* getNamedResourceOriginalFilename (const char* resourceNameUTF8)\n";
+    index << "    {\n";
+    index << "        for (int i = 0; i < namedResourceListSize; ++i)\n";
+    index << "        {\n";
+    index << "            if (std::strcmp (namedResourceList[i], resourceNameUTF8) == 0)\n";
+    index << "            {\n";
+    index << "                return originalFilenames[i];\n";
+    index << "            }\n";
+    index << "        }\n";
+    index << "        return nullptr;\n";
+    index << "    }\n";
+    index << "}\n";
+
+    data.header = header.str();
+    data.index = index.str();
+
+    std::vector<resourcePiece> pieces;
+    for (size_t i = 0; i < resources.size(); i++)
+    {
+        if (parts[i].empty())
+        {
+            pieces.push_back({ i, 0, 0, sizes[i] });
+            continue;
+        }
+        uint64_t offset = 0;
+        for (size_t k = 0; k < parts[i].size(); k++)
+        {
+            pieces.push_back({ i, k + 1, offset, parts[i][k] });
+            offset += parts[i][k];
+        }
+    }
+
+    auto &shards = data.shards;
+    uint64_t shardBytes = 0;
+    for (auto const& piece : pieces)
+    {
+        if (shards.empty() || (shardBytes + piece.length > opts.embedShardSize && shardBytes != 0))
+        {
+            shards.emplace_back();
+            shardBytes = 0;
+        }
+        shards.back().push_back(piece);
+        shardBytes += piece.length;
+    }
+}
+
+/* the --embed arguments of a piece without its file: [--compress] [--part=<offset>:[<length>]] <symbol> */
+std::string project::get_embed_argument(const project::resourceData &data, const project::resourcePiece &piece)
+{
+    std::string argument = data.compressed[piece.file] ? "--compress " : "";
+    if (piece.part == 0)
+    {
+        return argument + data.symbols[piece.file];
+    }
+    argument += "--part=" + std::to_string(piece.offset) + ":";
+    if (piece.part < data.parts[piece.file].size())
+    {
+        argument += std::to_string(piece.length);
+    }
+    return argument + " " + data.symbols[piece.file] + "_part" + std::to_string(piece.part);
 }
 
+/*
+ * The resources are split into shards of about opts.embedShardSize bytes, each shard a
+ * translation unit that is rebuilt only when one of its files changes, plus an index
+ * (BinaryData.h and the lookup functions) that depends on the resource names only.  The
+ * shards are written by `jucer2cmake --embed`, or by a CMake script when the generator is
+ * not installed.  The script and index are written at configure time and only touched when
+ * their content changes.
+ */
 std::string project::get_resource_files()
 {
-    std::stringstream ss;
+    resourceData data;
+    get_resource_data(data);
+    auto const& resources = data.files;
+    auto const& shards = data.shards;
 
-    pugi::xpath_node_set resources = m_Doc.select_nodes("/JUCERPROJECT/MAINGROUP/GROUP[@name = 'Resources']/FILE");
+    std::stringstream ss;
 
     ss << "\n";
     ss << "set(RESOURCE_FILES\n";
-    std::string directory;
-    for (pugi::xpath_node_set::const_iterator it = resources.begin(); it != resources.end(); ++it)
+    for (auto const& file : resources)
     {
-        pugi::xpath_node node = *it;
-        std::string file = node.node().attribute("file").as_string();
-        directory = file.substr(0, file.find_first_of("\\/"));
         ss << "\n    " << file;
     }
     ss << "\n";
     ss << ")\n";
     ss << "\n";
 
-    if(directory.empty())
+    if (resources.empty())
     {
-        std::cout << "Default Resource Folder Name" << std::endl;
-        directory = "Resources";
+        return ss.str();
     }
 
-    ss << "if(RESOURCE_FILES)\n";
-    ss << "    add_custom_command(\n";
-    ss << "        OUTPUT BinaryData.cpp BinaryData.h\n";
-    ss << "        COMMAND ${BINARY_BUILDER}\n";
-    ss << "        ARGS ${CMAKE_CURRENT_SOURCE_DIR}/" << directory << " ${CMAKE_CURRENT_SOURCE_DIR}/JuceLibraryCode BinaryData\n";
-    ss << "    )\n";
-    ss << "    add_custom_target(BinaryData DEPENDS BinaryData.cpp BinaryData.h)\n";
+    ss << "set(BINARY_DATA_DIR ${CMAKE_CURRENT_BINARY_DIR}/BinaryData)\n";
+    ss << "\n";
+    ss << "function(jucer_write_if_changed file content)\n";
+    ss << "    if(EXISTS ${file})\n";
+    ss << "        file(READ ${file} current)\n";
+    ss << "    endif()\n";
+    ss << "    if(NOT current STREQUAL content)\n";
+    ss << "        file(WRITE ${file} \"${content}\")\n";
+    ss << "    endif()\n";
+    ss << "endfunction()\n";
+    ss << "\n";
+    ss << "jucer_write_if_changed(${BINARY_DATA_DIR}/embed.cmake [==[\n" << EMBED_SCRIPT << "]==])\n";
+    if (opts.compressResources)
+    {
+        ss << "jucer_write_if_changed(${BINARY_DATA_DIR}/BinaryDataDecoder.h [==[\n" << DECODER_HEADER << "]==])\n";
+    }
+    ss << "jucer_write_if_changed(${BINARY_DATA_DIR}/BinaryData.h [==[\n" << data.header << "]==])\n";
+    ss << "jucer_write_if_changed(${BINARY_DATA_DIR}/BinaryData.cpp [==[\n" << data.index << "]==])\n";
+    ss << "\n";
+    // the shards have to match the index, an encoder of another version is not used
+    ss << "find_program(JUCER2CMAKE_PROGRAM jucer2cmake)\n";
+    ss << "set(JUCER2CMAKE_VERSION)\n";
+    ss << "if(JUCER2CMAKE_PROGRAM)\n";
+    ss << "    execute_process(COMMAND ${JUCER2CMAKE_PROGRAM} --version OUTPUT_VARIABLE JUCER2CMAKE_VERSION OUTPUT_STRIP_TRAILING_WHITESPACE ERROR_QUIET)\n";
     ss << "endif()\n";
+    ss << "if(JUCER2CMAKE_VERSION STREQUAL \"" << get_version() << "\")\n";
+    ss << "    set(BINARY_DATA_EMBED ${JUCER2CMAKE_PROGRAM} --embed)\n";
+    ss << "    set(BINARY_DATA_EMBED_DEPENDS ${JUCER2CMAKE_PROGRAM})\n";
+    ss << "    message(STATUS \"Resource encoder ....... ${JUCER2CMAKE_PROGRAM}\")\n";
+    ss << "else()\n";
+    ss << "    if(JUCER2CMAKE_PROGRAM)\n";
+    ss << "        message(STATUS \"Not using ${JUCER2CMAKE_PROGRAM}, it is version ${JUCER2CMAKE_VERSION} instead of " << get_version() << "\")\n";
+    ss << "    endif()\n";
+    ss << "    set(BINARY_DATA_EMBED ${CMAKE_COMMAND} -P ${BINARY_DATA_DIR}/embed.cmake --)\n";
+    ss << "    set(BINARY_DATA_EMBED_DEPENDS ${BINARY_DATA_DIR}/embed.cmake)\n";
+    ss << "    message(STATUS \"Resource encoder ....... CMake script\")\n";
+    ss << "endif()\n";
+    ss << "\n";
+
+    ss << "set(BINARY_DATA_SOURCES ${BINARY_DATA_DIR}/BinaryData.cpp)\n";
+    for (size_t k = 0; k < shards.size(); k++)
+    {
+        std::string output = "${BINARY_DATA_DIR}/BinaryData_" + std::to_string(k + 1) + ".cpp";
+        ss << "add_custom_command(\n";
+        ss << "    OUTPUT " << output << "\n";
+        ss << "    COMMAND ${BINARY_DATA_EMBED} " << output;
+        for (auto const& piece : shards[k])
+        {
+            ss << "\n        " << get_embed_argument(data, piece) << "=${CMAKE_CURRENT_SOURCE_DIR}/" << resources[piece.file];
+        }
+        ss << "\n";
+        ss << "    DEPENDS";
+        for (auto const& piece : shards[k])
+        {
+            ss << "\n        ${CMAKE_CURRENT_SOURCE_DIR}/" << resources[piece.file];
+        }
+        ss << "\n        ${BINARY_DATA_EMBED_DEPENDS}\n";
+        ss << "    VERBATIM\n";
+        ss << ")\n";
+        ss << "list(APPEND BINARY_DATA_SOURCES " << output << ")\n";
+    }
+    ss << "\n";
+    ss << "# the resources are compiled from BINARY_DATA_SOURCES, a few files per shard\n";
+    ss << "list(REMOVE_ITEM JUCE_LIBRARY_CODE_CPP JuceLibraryCode/BinaryData.cpp)\n";
+    ss << "set_source_files_properties(${BINARY_DATA_SOURCES} PROPERTIES SKIP_UNITY_BUILD_INCLUSION ON SKIP_PRECOMPILE_HEADERS ON)\n";
     ss << "\n";
 
     return ss.str();
@@ -57,15 +661,9 @@ std::vector<std::string> project::get_export_formats()
 {
     std::vector<std::string> res;
 
-    pugi::xpath_node_set xformats = m_Doc.select_nodes("/JUCERPROJECT/EXPORTFORMATS");
-
-    for (pugi::xpath_node_set::const_iterator it = xformats.begin(); it != xformats.end(); ++it)
+    for (auto const& build : exporters)
     {
-        pugi::xpath_node node = *it;
-        for (pugi::xml_node child: node.node().children())
-        {
-            res.push_back(child.name());
-        }
+        res.push_back(build.format);
     }
 
     return res;
@@ -74,30 +672,19 @@ std::vector<std::string> project::get_export_formats()
 std::list<std::string> project::get_module_path_list()
 {
     std::list<std::string> list;
-    std::vector<std::string> export_formats = get_export_formats();
 
-    for(auto const& format : export_formats)
+    for (auto const& build : exporters)
     {
-        std::string xpath = "/JUCERPROJECT/EXPORTFORMATS/" + format + "/MODULEPATHS/MODULEPATH";
-        pugi::xpath_node_set paths = m_Doc.select_nodes(xpath.c_str());
-        for (pugi::xpath_node_set::const_iterator it = paths.begin(); it != paths.end(); ++it)
+        for (auto const& path : build.modulePaths)
         {
-            pugi::xpath_node node = *it;
-            std::string path = node.node().attribute("path").value();
-            if(!path.empty())
+            // keep looking for non-empty path
+            if (!path.empty() && std::find(list.begin(), list.end(), path) == list.end())
             {
                 list.push_back(path);
             }
-            else
-            {
-                // keep looking for non-empty path
-                continue;
-            }
         }
     }
 
-    list.unique();
-
     return list;
 }
 
@@ -112,179 +699,653 @@ std::string project::get_module_paths()
     return ss.str();
 }
 
+/* JuceLibraryCode sources when the generator runs, derived from the module list if the folder does not exist yet */
+void project::get_library_code(std::vector<std::string> &cpp, std::vector<std::string> &mm)
+{
+    profiler::count(profiler::fsOpendir);
+    DIR *dir = opendir((base_path + sepd + "JuceLibraryCode").c_str());
+    if (!dir)
+    {
+        for (auto const& id : modules)
+        {
+            cpp.push_back("JuceLibraryCode/include_" + id + ".cpp");
+            mm.push_back("JuceLibraryCode/include_" + id + ".mm");
+        }
+        return;
+    }
+
+    struct dirent *dp;
+    while ((dp = readdir(dir)) != NULL)
+    {
+        std::string file = dp->d_name;
+        size_t dot = file.find_last_of('.');
+        std::string ext = (dot == std::string::npos) ? "" : file.substr(dot);
+        if (ext == ".cpp")
+        {
+            cpp.push_back("JuceLibraryCode/" + file);
+        }
+        else if (ext == ".mm")
+        {
+            mm.push_back("JuceLibraryCode/" + file);
+        }
+    }
+    closedir(dir);
+
+    std::sort(cpp.begin(), cpp.end());
+    std::sort(mm.begin(), mm.end());
+}
+
+/*
+ * The JuceLibraryCode sources are listed explicitly, so a build does not glob the folder.  The
+ * folder itself is a configure dependency: only when files are added or removed CMake reruns
+ * and checks the list, falling back to what it finds until the CMakeLists.txt is regenerated.
+ */
 std::string project::get_autogen_vars()
 {
+    std::vector<std::string> cpp;
+    std::vector<std::string> mm;
+    get_library_code(cpp, mm);
+
     std::stringstream ss;
 
     ss << "if(APPLE)\n";
-    ss << "    file(GLOB JUCE_LIBRARY_CODE_CPP RELATIVE ${CMAKE_SOURCE_DIR} CONFIGURE_DEPENDS\n";
-    ss << "       JuceLibraryCode/*.mm\n";
-    ss << "       JuceLibraryCode/BinaryData.cpp\n";
+    ss << "    set(JUCE_LIBRARY_CODE_CPP\n";
+    for (auto const& file : mm)
+    {
+        ss << "        " << file << "\n";
+    }
+    if (std::find(cpp.begin(), cpp.end(), "JuceLibraryCode/BinaryData.cpp") != cpp.end())
+    {
+        ss << "        JuceLibraryCode/BinaryData.cpp\n";
+    }
     ss << "    )\n";
+    ss << "    set(JUCE_LIBRARY_CODE_PATTERNS JuceLibraryCode/*.mm JuceLibraryCode/BinaryData.cpp)\n";
     ss << "    if(CMAKE_BUILD_TYPE STREQUAL \"Debug\")\n";
     ss << "        add_compile_definitions(DEBUG)\n";
     ss << "    endif()\n";
     ss << "else()\n";
-    ss << "    file(GLOB JUCE_LIBRARY_CODE_CPP RELATIVE ${CMAKE_SOURCE_DIR} CONFIGURE_DEPENDS JuceLibraryCode/*.cpp)\n";
-    ss << "endif()";
+    ss << "    set(JUCE_LIBRARY_CODE_CPP\n";
+    for (auto const& file : cpp)
+    {
+        ss << "        " << file << "\n";
+    }
+    ss << "    )\n";
+    ss << "    set(JUCE_LIBRARY_CODE_PATTERNS JuceLibraryCode/*.cpp)\n";
+    ss << "endif()\n";
     ss << "\n";
+    ss << "if(EXISTS ${CMAKE_CURRENT_SOURCE_DIR}/JuceLibraryCode)\n";
+    ss << "    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${CMAKE_CURRENT_SOURCE_DIR}/JuceLibraryCode)\n";
+    ss << "    file(GLOB JUCE_LIBRARY_CODE_FOUND RELATIVE ${CMAKE_SOURCE_DIR} ${JUCE_LIBRARY_CODE_PATTERNS})\n";
+    ss << "    list(SORT JUCE_LIBRARY_CODE_FOUND)\n";
+    ss << "    set(JUCE_LIBRARY_CODE_LISTED ${JUCE_LIBRARY_CODE_CPP})\n";
+    ss << "    list(SORT JUCE_LIBRARY_CODE_LISTED)\n";
+    ss << "    if(NOT JUCE_LIBRARY_CODE_FOUND STREQUAL JUCE_LIBRARY_CODE_LISTED)\n";
+    ss << "        message(WARNING \"JuceLibraryCode changed, run jucer2cmake to update CMakeLists.txt\")\n";
+    ss << "        set(JUCE_LIBRARY_CODE_CPP ${JUCE_LIBRARY_CODE_FOUND})\n";
+    ss << "    endif()\n";
+    ss << "endif()\n";
 
     return ss.str();
 }
 
-std::vector<std::string> project::get_module_list()
+const std::vector<std::string>& project::get_module_list()
 {
-    std::vector<std::string> res;
+    return modules;
+}
 
-    pugi::xpath_node_set set = m_Doc.select_nodes("/JUCERPROJECT/MODULES/MODULE");
-    for (pugi::xpath_node_set::const_iterator it = set.begin(); it != set.end(); ++it)
+/* Looks up each module in the module paths through the persistent module index */
+void project::resolve_modules()
+{
+    if(modulesResolved)
     {
-        pugi::xpath_node node = *it;
-        res.push_back(node.node().attribute("id").value());
+        return;
     }
+    modulesResolved = true;
+    profiler::scope s("module discovery");
 
-    return res;
-}
-
-std::list<std::string> project::get_libraries(const project::map_t& system)
-{
-    std::list<std::string> res;
-    for(auto &item : get_module_list())
+    // one lookup per search path for all remaining modules
+    std::vector<std::string> remaining = modules;
+    std::map<std::string, moduleIndex::entry> found;
+    for(auto const& path : get_module_path_list())
     {
-        //std::cout << "Module: " << item << "\n";
-        if ( system.find(item) != system.end() )
+        if(remaining.empty())
         {
-            auto libs = system.at(item);
-            //std::cout << "libs: " << libs << "\n";
-            for(auto const &lib : utilities::getValueList(libs))
-            {
-                //std::cout << "lib: [" << lib << "]\n";
-                res.push_back(lib);
-            }
+            break;
         }
+        moduleIndex::instance().find(base_path + sepd + path, remaining, found);
     }
-    res.sort();
-    res.unique();
-    #if 0
-    std::cout << "Libraries" << std::endl;
-    for(auto const& item : res)
+
+    for(auto const& id : modules)
     {
-        std::cout << "[" << item << "]" << std::endl;
+        auto it = found.find(id);
+        if(it != found.end())
+        {
+            juceModules.push_back(module(it->second.header, it->second.metaData));
+        }
     }
-    #endif
-
-    return res;
-}
-
-std::string project::get_modules()
-{
-    std::stringstream ss;
 
-    pugi::xpath_node_set modules = m_Doc.select_nodes("/JUCERPROJECT/MODULES/MODULE");
-    for (pugi::xpath_node_set::const_iterator it = modules.begin(); it != modules.end(); ++it)
+    for(auto const& warning : moduleIndex::instance().takeWarnings())
     {
-        pugi::xpath_node node = *it;
-        ss << "    JuceLibraryCode/include_" << node.node().attribute("id").value() << ".cpp\n";
+        report({ diagnostic::warning, warning, jucer_file, 0, -1 });
     }
 
-    return ss.str();
+    moduleIndex::instance().save();
 }
 
-std::string project::get_source_groups()
+/*
+ * Checks the dependencies declared by the module headers that were found: those on modules
+ * missing from the project are reported, a cycle is reported and returns false.
+ */
+bool project::check_module_dependencies()
 {
-    std::stringstream ss;
+    resolve_modules();
 
-    pugi::xpath_node_set sources = m_Doc.select_nodes("/JUCERPROJECT/MAINGROUP/GROUP[@name = 'Source']/FILE");
-    ss << "\nsource_group (Source FILES\n";
-    for (pugi::xpath_node_set::const_iterator it = sources.begin(); it != sources.end(); ++it)
+    std::map<std::string, std::vector<std::string>> dependencies;
+    for(auto &m : juceModules)
     {
-        pugi::xpath_node node = *it;
-        if(!node.node().attribute("resource").as_bool()) {
-            ss << "\n    " << node.node().attribute("file").value();
+        std::string id = m.getID();
+        std::string declared = m.getDependencies();
+        for(auto const &dep : utilities::getValueList(declared))
+        {
+            if(std::find(modules.begin(), modules.end(), dep) != modules.end())
+            {
+                dependencies[id].emplace_back(dep);
+            }
+            else
+            {
+                report({ diagnostic::warning, "Module " + id + " depends on " + std::string(dep) + ", which is not in the project", jucer_file, 0, -1 });
+            }
         }
     }
-    ss << "\n";
-    ss << ")\n";
 
-    pugi::xpath_node_set source_groups = m_Doc.select_nodes("/JUCERPROJECT/MAINGROUP/GROUP[@name = 'Source']/GROUP");
-    for (pugi::xpath_node_set::const_iterator it = source_groups.begin(); it != source_groups.end(); ++it)
+    // remove the modules whose dependencies are all removed, what remains depends on a cycle
+    std::set<std::string> remaining(modules.begin(), modules.end());
+    bool removed = true;
+    while(removed)
     {
-        pugi::xpath_node node = *it;
-        ss << "\nsource_group (Source\\\\" << node.node().attribute("name").value() << " FILES\n";
-
-        std::stringstream q;
-        q << "/JUCERPROJECT/MAINGROUP/GROUP/GROUP[@name = '" << node.node().attribute("name").value() << "']/FILE";
-        pugi::xpath_node_set sub_source = m_Doc.select_nodes(q.str().c_str());
-        for (pugi::xpath_node_set::const_iterator it = sub_source.begin(); it != sub_source.end(); ++it)
+        removed = false;
+        for(auto const &id : remaining)
         {
-            pugi::xpath_node node = *it;
-            ss << "\n    " << node.node().attribute("file").value();
+            auto const &deps = dependencies[id];
+            if(std::none_of(deps.begin(), deps.end(), [&](const std::string &dep) { return remaining.count(dep) != 0; }))
+            {
+                remaining.erase(id);
+                removed = true;
+                break;
+            }
         }
-        ss << "\n)\n";
     }
-    ss << "\n";
-
-    return ss.str();
-}
-
-std::string project::get_source_list()
-{
-    std::stringstream ss;
-
-    ss << "set(SRC_FILES\n";
-
-    pugi::xpath_node_set files = m_Doc.select_nodes("/JUCERPROJECT/MAINGROUP/GROUP/FILE");
-    for (pugi::xpath_node_set::const_iterator it = files.begin(); it != files.end(); ++it)
+    if(remaining.empty())
     {
-        pugi::xpath_node node = *it;
-        if(node.node().attribute("compile").as_bool()) {
-            ss << "\n    " << node.node().attribute("file").value();
-        }
+        return true;
     }
 
-    files = m_Doc.select_nodes("/JUCERPROJECT/MAINGROUP/GROUP/GROUP/FILE");
-    for (pugi::xpath_node_set::const_iterator it = files.begin(); it != files.end(); ++it)
+    // drop the modules that only depend on a cycle, what remains is on one
+    bool dropped = true;
+    while(dropped)
     {
-        pugi::xpath_node node = *it;
-        if(node.node().attribute("compile").as_bool()) {
-            ss << "\n    " << node.node().attribute("file").value();
+        dropped = false;
+        for(auto const &id : remaining)
+        {
+            bool needed = std::any_of(remaining.begin(), remaining.end(), [&](const std::string &other)
+            {
+                auto const &deps = dependencies[other];
+                return std::find(deps.begin(), deps.end(), id) != deps.end();
+            });
+            if(!needed)
+            {
+                remaining.erase(id);
+                dropped = true;
+                break;
+            }
         }
     }
 
-    files = m_Doc.select_nodes("/JUCERPROJECT/MAINGROUP/GROUP/GROUP/GROUP/FILE");
-    for (pugi::xpath_node_set::const_iterator it = files.begin(); it != files.end(); ++it)
+    std::string cycle;
+    for(auto const &id : modules)
     {
-        pugi::xpath_node node = *it;
-        if(node.node().attribute("compile").as_bool()) {
-            ss << "\n    " << node.node().attribute("file").value();
+        if(remaining.count(id) != 0)
+        {
+            cycle += " " + id;
         }
     }
+    report({ diagnostic::error, "Cyclic module dependencies between:" + cycle, jucer_file, 0, -1 });
+    return false;
+}
 
-    files = m_Doc.select_nodes("/JUCERPROJECT/MAINGROUP/GROUP/GROUP/GROUP/GROUP/FILE");
-    for (pugi::xpath_node_set::const_iterator it = files.begin(); it != files.end(); ++it)
+/*
+ * One object library per module wrapper, in declaration order, linked by the project target.
+ * Object libraries keep every object, such as the plugin entry points a static archive would
+ * drop, and are not linked to each other: that would pass on nothing but make every module wait
+ * for the ones it depends on, so all modules build in parallel and the declared dependencies are
+ * only checked.  The modules compile with the project target's definitions, include directories
+ * and options, read when CMake generates.  They get the project target's LTO settings but not its
+ * precompiled header, which the module wrappers skip as they include the module sources directly.
+ */
+std::string project::get_module_libraries()
+{
+    if(name.empty() || modules.empty() || !check_module_dependencies())
     {
-        pugi::xpath_node node = *it;
-        if(node.node().attribute("compile").as_bool()) {
-            ss << "\n    " << node.node().attribute("file").value();
-        }
+        return "";
     }
 
+    std::stringstream ss;
+    ss << "option(JUCER_MODULE_LIBRARIES \"Compile each JUCE module as its own object library\" ON)\n";
     ss << "\n";
-    ss << ")\n";
+    ss << "set(JUCER_MODULE_TARGETS)\n";
+    ss << "if(JUCER_MODULE_LIBRARIES)\n";
+    ss << "    function(jucer_module_library target source)\n";
+    ss << "        list(FIND JUCE_LIBRARY_CODE_CPP ${source} index)\n";
+    ss << "        if(index EQUAL -1)\n";
+    ss << "            return()\n";
+    ss << "        endif()\n";
+    ss << "        list(REMOVE_AT JUCE_LIBRARY_CODE_CPP ${index})\n";
+    ss << "        add_library(${target} OBJECT ${source})\n";
+    ss << "        target_compile_definitions(${target} PRIVATE $<TARGET_PROPERTY:" << name << ",COMPILE_DEFINITIONS>)\n";
+    ss << "        target_include_directories(${target} PRIVATE $<TARGET_PROPERTY:" << name << ",INCLUDE_DIRECTORIES>)\n";
+    ss << "        target_compile_options(${target} PRIVATE $<TARGET_PROPERTY:" << name << ",COMPILE_OPTIONS>)\n";
+    ss << "        if(EXTERNAL_JUCE)\n";
+    ss << "            add_dependencies(${target} juce_root)\n";
+    ss << "        endif()\n";
+    ss << "        set(JUCE_LIBRARY_CODE_CPP ${JUCE_LIBRARY_CODE_CPP} PARENT_SCOPE)\n";
+    ss << "        set(JUCER_MODULE_TARGETS ${JUCER_MODULE_TARGETS} ${target} PARENT_SCOPE)\n";
+    ss << "    endfunction()\n";
+    ss << "\n";
+    ss << "    set(JUCER_MODULE_EXT cpp)\n";
+    ss << "    if(APPLE)\n";
+    ss << "        set(JUCER_MODULE_EXT mm)\n";
+    ss << "    endif()\n";
+
+    for(auto const &id : modules)
+    {
+        ss << "    jucer_module_library(" << name << "_" << id << " JuceLibraryCode/include_" << id << ".${JUCER_MODULE_EXT})\n";
+    }
+    ss << "endif()\n";
     ss << "\n";
+
     return ss.str();
 }
 
-project::project(std::string file, std::string outpath)
+/* Libraries declared by the module headers, the static tables are used for modules that were not found */
+std::list<std::string> project::get_libraries(const project::map_t& system, std::string (module::*field)())
 {
-    static constexpr char DEFAULT_VERSION[] = { '1', '.', '0', '.', '0', 0 };
-
-    version = DEFAULT_VERSION;
+    resolve_modules();
 
-    base_path = file.substr(0, file.find_last_of("\\/"));
-    sepd = (base_path.find("\\") != std::string::npos) ? "\\" : "/";
-
-    if(outpath.empty())
+    std::list<std::string> res;
+    for(auto &item : modules)
+    {
+        auto m = std::find_if(juceModules.begin(), juceModules.end(), [&](module &mod) { return mod.getID() == item; });
+        if(m != juceModules.end())
+        {
+            std::string libs = ((*m).*field)();
+            for(auto const &lib : utilities::getValueList(libs))
+            {
+                res.emplace_back(lib);
+            }
+        }
+        else if ( system.find(item) != system.end() )
+        {
+            for(auto const &lib : utilities::getValueList(system.at(item)))
+            {
+                res.emplace_back(lib);
+            }
+        }
+    }
+    res.sort();
+    res.unique();
+
+    return res;
+}
+
+std::string project::get_modules()
+{
+    std::stringstream ss;
+
+    for (auto const& id : modules)
+    {
+        ss << "    JuceLibraryCode/include_" << id << ".cpp\n";
+    }
+
+    return ss.str();
+}
+
+std::string project::get_source_groups(const project::sourceGroup &group, std::string path)
+{
+    std::stringstream ss;
+
+    ss << "\nsource_group (" << path << " FILES\n";
+    for (auto const& index : group.files)
+    {
+        if (!files[index].resource)
+        {
+            ss << "\n    " << files[index].file;
+        }
+    }
+    ss << "\n)\n";
+
+    for (auto const& sub : group.groups)
+    {
+        ss << get_source_groups(sub, path + "\\\\" + sub.name);
+    }
+
+    return ss.str();
+}
+
+std::string project::get_source_groups()
+{
+    std::stringstream ss;
+
+    for (auto const& group : mainGroup.groups)
+    {
+        if (group.name == "Source")
+        {
+            ss << get_source_groups(group, "Source");
+        }
+    }
+    ss << "\n";
+
+    return ss.str();
+}
+
+std::string project::get_source_list()
+{
+    std::stringstream ss;
+
+    ss << "set(SRC_FILES\n";
+
+    for (auto const& f : files)
+    {
+        if (f.compile)
+        {
+            ss << "\n    " << f.file;
+        }
+    }
+
+    ss << "\n";
+    ss << ")\n";
+    ss << "\n";
+
+    if(opts.unity)
+    {
+        ss << get_unity_batches();
+    }
+
+    return ss.str();
+}
+
+/*
+ * Spreads the C++ sources over unity batches of about unityBatchSize bytes.  The largest
+ * files are placed first, each into the batch with the least code so far, so batches take
+ * a similar time to compile.  Excluded files are compiled on their own.
+ */
+std::string project::get_unity_batches()
+{
+    std::vector<size_t> sources;
+    std::vector<std::string> excluded;
+    std::vector<off_t> sizes(files.size(), 0);
+    off_t total = 0;
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        auto const& f = files[i];
+        std::string ext = f.file.substr(f.file.find_last_of('.') + 1);
+        if (!f.compile || (ext != "cpp" && ext != "cc" && ext != "cxx"))
+        {
+            continue;
+        }
+
+        bool skip = std::any_of(opts.unityExclude.begin(), opts.unityExclude.end(), [&](const std::string &pattern)
+        {
+            return fnmatch(pattern.c_str(), f.file.c_str(), 0) == 0;
+        });
+        if (skip)
+        {
+            excluded.push_back(f.file);
+            continue;
+        }
+
+        struct stat info;
+        std::string path = base_path + sepd + f.file;
+        profiler::count(profiler::fsStat);
+        sizes[i] = (stat(path.c_str(), &info) == 0 && info.st_size > 0) ? info.st_size : 1;
+        total += sizes[i];
+        sources.push_back(i);
+    }
+
+    size_t count = std::max<size_t>(1, (total + opts.unityBatchSize - 1) / opts.unityBatchSize);
+    count = std::min(count, std::max<size_t>(1, sources.size()));
+
+    std::stable_sort(sources.begin(), sources.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+    std::vector<std::vector<size_t>> batches(count);
+    std::vector<off_t> load(count, 0);
+    for (auto const& index : sources)
+    {
+        size_t smallest = std::min_element(load.begin(), load.end()) - load.begin();
+        batches[smallest].push_back(index);
+        load[smallest] += sizes[index];
+    }
+
+    std::stringstream ss;
+    ss << "option(JUCER_UNITY_BUILD \"Compile the sources in size balanced unity batches\" ON)\n";
+    ss << "\n";
+    ss << "set(UNITY_BATCH_SIZE " << (sources.size() + count - 1) / std::max<size_t>(1, count) << ")\n";
+    for (size_t b = 0; b < batches.size(); b++)
+    {
+        if (batches[b].empty())
+        {
+            continue;
+        }
+        std::sort(batches[b].begin(), batches[b].end());
+        ss << "set_source_files_properties(\n";
+        for (auto const& index : batches[b])
+        {
+            ss << "    " << files[index].file << "\n";
+        }
+        ss << "    PROPERTIES UNITY_GROUP batch_" << b << "\n";
+        ss << ")\n";
+    }
+
+    if (!excluded.empty())
+    {
+        ss << "set_source_files_properties(\n";
+        for (auto const& file : excluded)
+        {
+            ss << "    " << file << "\n";
+        }
+        ss << "    PROPERTIES SKIP_UNITY_BUILD_INCLUSION ON\n";
+        ss << ")\n";
+    }
+    ss << "\n";
+
+    return ss.str();
+}
+
+void project::parse_config(pugi::xml_node node, project::buildConfig &config)
+{
+    config.name = node.attribute("name").as_string();
+    config.isDebug = node.attribute("isDebug").as_bool();
+    config.optimisation = node.attribute("optimisation").as_bool();
+    config.targetName = node.attribute("targetName").as_string();
+    auto _headerPath = utilities::split(node.attribute("headerPath").as_string(), '\n');
+    config.headerPath.assign(_headerPath.begin(), _headerPath.end());
+    auto _libraryPath = utilities::split(node.attribute("libraryPath").as_string(), '\n');
+    config.libraryPath.assign(_libraryPath.begin(), _libraryPath.end());
+    config.valid = true;
+}
+
+void project::parse_export(pugi::xml_node node, project::buildExport &build)
+{
+    build.format = node.name();
+    build.targetFolder = node.attribute("targetFolder").value();
+    auto _extraDefs = utilities::split(node.attribute("extraDefs").value(), '\n');
+    build.extraDefs.assign(_extraDefs.begin(), _extraDefs.end());
+    auto _externalLibraries = utilities::split(node.attribute("externalLibraries").value(), '\n');
+    build.externalLibraries.assign(_externalLibraries.begin(), _externalLibraries.end());
+    build.extraLinkerFlags = node.attribute("extraLinkerFlags").value();
+    build.cppLanguageStandard = node.attribute("cppLanguageStandard").value();
+    build.extraCompilerFlags = node.attribute("extraCompilerFlags").value();
+    build.extraFrameworks = node.attribute("extraFrameworks").value();
+    build.smallIcon = node.attribute("smallIcon").value();
+    build.bigIcon = node.attribute("bigIcon").value();
+    build.vstLegacyFolder = node.attribute("vstLegacyFolder").value();
+    build.vst3Folder = node.attribute("vst3Folder").value();
+    build.microphonePermissionNeeded = node.attribute("microphonePermissionNeeded").as_bool();
+    build.debug.valid = false;
+    build.release.valid = false;
+    build.valid = true;
+
+    for (pugi::xml_node child : node.children())
+    {
+        std::string type = child.name();
+        if (type == "CONFIGURATIONS")
+        {
+            for (pugi::xml_node config : child.children("CONFIGURATION"))
+            {
+                project::buildConfig c;
+                parse_config(config, c);
+                if (c.name == "Debug")
+                {
+                    build.debug = c;
+                }
+                else if (c.name == "Release")
+                {
+                    build.release = c;
+                }
+                build.configurations.push_back(c);
+            }
+        }
+        else if (type == "MODULEPATHS")
+        {
+            for (pugi::xml_node path : child.children("MODULEPATH"))
+            {
+                build.modulePaths.push_back(path.attribute("path").value());
+            }
+        }
+    }
+}
+
+void project::parse_group(pugi::xml_node node, project::sourceGroup &group)
+{
+    group.id = node.attribute("id").as_string();
+    group.name = node.attribute("name").as_string();
+
+    for (pugi::xml_node child : node.children())
+    {
+        std::string type = child.name();
+        if (type == "FILE")
+        {
+            project::sourceFile f;
+            f.id = child.attribute("id").as_string();
+            f.name = child.attribute("name").as_string();
+            f.file = child.attribute("file").as_string();
+            f.compile = child.attribute("compile").as_bool();
+            f.resource = child.attribute("resource").as_bool();
+            group.files.push_back(files.size());
+            files.push_back(f);
+        }
+        else if (type == "GROUP")
+        {
+            group.groups.push_back(project::sourceGroup());
+            parse_group(child, group.groups.back());
+        }
+    }
+}
+
+/* Builds the project model in one pass over the document, the emitters only read the model */
+void project::parse(pugi::xml_node node)
+{
+    for (pugi::xml_node child : node.children())
+    {
+        std::string type = child.name();
+        if (type == "MAINGROUP")
+        {
+            parse_group(child, mainGroup);
+        }
+        else if (type == "EXPORTFORMATS")
+        {
+            for (pugi::xml_node format : child.children())
+            {
+                exporters.push_back(project::buildExport());
+                parse_export(format, exporters.back());
+            }
+        }
+        else if (type == "MODULES")
+        {
+            for (pugi::xml_node module : child.children("MODULE"))
+            {
+                modules.push_back(module.attribute("id").value());
+            }
+        }
+    }
+}
+
+std::string project::get_version()
+{
+    return J2C_VERSION;
+}
+
+std::string project::format_diagnostic(const project::diagnostic &d)
+{
+    if (d.level == diagnostic::error && d.offset >= 0)
+    {
+        return d.file + ":" + std::to_string(d.line) + ": " + d.message + " (offset " + std::to_string(d.offset) + ")";
+    }
+    return d.message;
+}
+
+void project::print_diagnostic(const project::diagnostic &d)
+{
+    std::ostream &os = (d.level == diagnostic::note) ? std::cout : std::cerr;
+    os << format_diagnostic(d) << std::endl;
+}
+
+project::project(std::string file, std::string outpath, const project::options &o, reporter r)
+{
+    opts = o;
+    report = r;
+    std::unique_ptr<mappedFile> jucer;
+    {
+        profiler::scope s("jucer read", file);
+        jucer.reset(new mappedFile(file, true));
+        if(!jucer->isOpen())
+        {
+            throw std::runtime_error("Error opening file: " + file);
+        }
+    }
+    load(file, outpath, jucer->data(), jucer->size(), nullptr);
+}
+
+project::project(const char *data, size_t length, std::string file, std::string outpath, const project::options &o, reporter r)
+{
+    opts = o;
+    report = r;
+    std::string text(data, length);
+    load(file, outpath, &text[0], text.size(), data);
+}
+
+/*
+ * Attributes are all the emitters read: no PCDATA or CDATA is used, and with whitespace
+ * conversion of attributes end-of-line normalization does not change them.  The buffer is
+ * parsed in place, so the attribute strings point into it instead of into a copy.
+ */
+static const unsigned int JUCER_PARSE_FLAGS = pugi::parse_escapes | pugi::parse_wconv_attribute;
+
+void project::load(std::string file, std::string outpath, char *text, size_t length, const char *original)
+{
+    static constexpr char DEFAULT_VERSION[] = { '1', '.', '0', '.', '0', 0 };
+
+    version = DEFAULT_VERSION;
+    pluginAAXCategory = -1;
+    downloadJuceSource = false;
+    modulesResolved = false;
+    jucer_file = file;
+
+    size_t sep = file.find_last_of("\\/");
+    base_path = (sep == std::string::npos) ? "." : file.substr(0, sep);
+    sepd = (base_path.find("\\") != std::string::npos) ? "\\" : "/";
+
+    if(outpath.empty())
     {
         output_path = base_path;
     }
@@ -293,15 +1354,33 @@ project::project(std::string file, std::string outpath)
         output_path = outpath;
     }
 
-    pugi::xml_parse_result result = m_Doc.load_file(file.c_str());
+    profiler::scope s("xml load", file);
+    // the parse overwrites the text, hash it first
+    jucer_hash = utilities::hash(text, length);
+    // the model copies what it reads, the document, its nodes and the text only live for the
+    // parse; the arena is declared first so that it outlives the document
+    std::shared_ptr<arena> domArena = arena::acquire();
+    pugi::xml_document doc;
+    pugi::xml_parse_result result;
+    {
+        arena::scope a(*domArena);
+        result = doc.load_buffer_inplace(text, length, JUCER_PARSE_FLAGS);
+    }
     if (!result)
     {
-        std::cout << "XML [" << file << "] parsed with errors\n";
-        std::cout << "Error description: " << result.description() << "\n";
-        std::cout << "Error offset: " << result.offset << " (error at [..." << (file.c_str() + result.offset) << "]\n" << std::endl;
+        std::string pristine;
+        if(!original && utilities::readFile(file, pristine))
+        {
+            original = pristine.data();
+            length = std::min(length, pristine.size());
+        }
+        size_t offset = std::min(static_cast<size_t>(result.offset), length);
+        long line = original ? 1 + std::count(original, original + offset, '\n') : 0;
+        report({ diagnostic::error, std::string("XML parse error: ") + result.description(), file, line, static_cast<long>(offset) });
+        throw std::runtime_error("XML parse error: " + std::string(result.description()));
     }
 
-    for (pugi::xml_node node: m_Doc.children("JUCERPROJECT"))
+    for (pugi::xml_node node: doc.children("JUCERPROJECT"))
     {
         id = node.attribute("id").as_string();
         name = node.attribute("name").as_string();
@@ -344,19 +1423,42 @@ project::project(std::string file, std::string outpath)
         pluginAAXCategory = node.attribute("pluginAAXCategory").as_int();
         jucerVersion = node.attribute("jucerVersion").as_string();
         companyName = node.attribute("companyName").as_string();
-        std::string _headerPath = node.attribute("headerPath").as_string();
-        if(!_headerPath.empty())
-        {
-            headerPath = utilities::split(_headerPath, '\n');
-        }
+        auto _headerPath = utilities::split(node.attribute("headerPath").as_string(), '\n');
+        headerPath.assign(_headerPath.begin(), _headerPath.end());
         companyWebsite = node.attribute("companyWebsite").as_string();
         defines = node.attribute("defines").as_string();
         pluginFormats = node.attribute("pluginFormats").as_string();
         pluginCharacteristicsValue = node.attribute("pluginCharacteristicsValue").as_string();
         userNotes = node.attribute("userNotes").as_string();
+
+        parse(node);
     }
 }
 
+/* the definitions the generator adds to the .jucer defines, in the order they are emitted */
+std::vector<std::string> project::get_definitions()
+{
+    std::stringstream hex;
+    auto ver = utilities::split(version, '.');
+    hex << "0x";
+    hex << std::hex << std::setw(2) << std::setfill('0') << ver[0];
+    hex << std::hex << std::setw(2) << std::setfill('0') << ver[1];
+    hex << std::hex << std::setw(2) << std::setfill('0') << ver[2];
+
+    return {
+        "JUCE_APP_VERSION=" + version,
+        "JUCE_APP_VERSION_HEX=" + hex.str(),
+        "JucePlugin_Build_VST=" + std::to_string(buildVST),
+        "JucePlugin_Build_VST3=" + std::to_string(buildVST3),
+        "JucePlugin_Build_AU=" + std::to_string(buildAU),
+        "JucePlugin_Build_AUv3=" + std::to_string(buildAUv3),
+        "JucePlugin_Build_RTAS=" + std::to_string(buildRTAS),
+        "JucePlugin_Build_AAX=" + std::to_string(buildAAX),
+        "JucePlugin_Build_Standalone=" + std::to_string(buildStandalone),
+        "JucePlugin_Build_Unity=" + std::to_string(buildUnity),
+    };
+}
+
 std::string project::get_defines()
 {
     std::stringstream ss;
@@ -368,21 +1470,10 @@ std::string project::get_defines()
         ss << "    " << defines << "\n";
     }
 
-    ss << "    JUCE_APP_VERSION=" << version << "\n";
-    ss << "    JUCE_APP_VERSION_HEX=0x";
-    auto ver = utilities::split(version, '.');
-    ss << std::hex << std::setw(2) << std::setfill('0') << ver[0];
-    ss << std::hex << std::setw(2) << std::setfill('0') << ver[1];
-    ss << std::hex << std::setw(2) << std::setfill('0') << ver[2];
-    ss << "\n";
-    ss << "    JucePlugin_Build_VST=" << buildVST << "\n";
-    ss << "    JucePlugin_Build_VST3=" << buildVST3 << "\n";
-    ss << "    JucePlugin_Build_AU=" << buildAU << "\n";
-    ss << "    JucePlugin_Build_AUv3=" << buildAUv3 << "\n";
-    ss << "    JucePlugin_Build_RTAS=" << buildRTAS << "\n";
-    ss << "    JucePlugin_Build_AAX=" << buildAAX << "\n";
-    ss << "    JucePlugin_Build_Standalone=" << buildStandalone << "\n";
-    ss << "    JucePlugin_Build_Unity=" << buildUnity << "\n";
+    for(auto const& def : get_definitions())
+    {
+        ss << "    " << def << "\n";
+    }
     ss << ")\n";
     ss << "\n";
     return ss.str();
@@ -426,7 +1517,7 @@ std::string project::get_header()
     ss << "################################################\n";
     ss << "\n";
     ss << "\n";
-    ss << "cmake_minimum_required(VERSION 3.11)\n";
+    ss << "cmake_minimum_required(VERSION 3.13)\n";
     ss << "\n";
     ss << "if(NOT CMAKE_BUILD_TYPE)\n";
     ss << "    set(CMAKE_BUILD_TYPE \"Release\" CACHE STRING \"Choose the type of build, options are: Debug, Release, or MinSizeRel.\" FORCE)\n";
@@ -462,14 +1553,15 @@ std::string project::get_dependencies()
 
         struct stat info;
         std::string pathname = base_path + sepd + path;
+        profiler::count(profiler::fsStat);
         if( stat( pathname.c_str(), &info ) == 0 )
         {
-            std::cout << "Valid: " << base_path << sepd << path << std::endl;
+            report({ diagnostic::note, "Valid: " + base_path + sepd + path, jucer_file, 0, -1 });
         }
         else
         {
-            std::cout << "Path not present: " << base_path << sepd << path << std::endl;
-            std::cout << "Configured to download JUCE" << std::endl;
+            report({ diagnostic::warning, "Path not present: " + base_path + sepd + path, jucer_file, 0, -1 });
+            report({ diagnostic::note, "Configured to download JUCE", jucer_file, 0, -1 });
 
             if(juceFolder.empty())
             {
@@ -501,6 +1593,105 @@ std::string project::get_dependencies()
     return ss.str();
 }
 
+/*
+ * Compiler launcher, ccache or sccache, set before any target is created.  ccache hashes paths
+ * below its base_dir relative to it and the prefix maps strip the checkout directory from
+ * debug info and __FILE__, so different checkouts of a project share cache entries.  The base
+ * directory covers the module and header paths the project reaches with "../".  ccache 4.8 and
+ * later take it on their command line; older ones only get it from the environment or their
+ * configuration, which the build cannot set without another process per compile.
+ */
+std::string project::get_compiler_cache()
+{
+    // the root is the outermost directory the project reaches with relative paths, e.g. ../JUCE/modules
+    std::vector<std::string> paths(headerPath.begin(), headerPath.end());
+    for(auto const& path : get_module_path_list())
+    {
+        paths.push_back(path);
+    }
+    for(auto const& build : exporters)
+    {
+        paths.insert(paths.end(), build.debug.headerPath.begin(), build.debug.headerPath.end());
+        paths.insert(paths.end(), build.release.headerPath.begin(), build.release.headerPath.end());
+    }
+    size_t up = 0;
+    for(auto const& path : paths)
+    {
+        size_t n = 0;
+        while(path.compare(n * 3, 2, "..") == 0 && (path.length() == n * 3 + 2 || path[n * 3 + 2] == '/' || path[n * 3 + 2] == '\\'))
+        {
+            n++;
+        }
+        up = std::max(up, n);
+    }
+    std::string root = "${CMAKE_SOURCE_DIR}";
+    for(size_t i = 0; i < up; i++)
+    {
+        root += "/..";
+    }
+
+    std::stringstream ss;
+    ss << "option(JUCER_COMPILER_CACHE \"Use ccache or sccache when available\" ON)\n";
+    ss << "\n";
+    ss << "if(JUCER_COMPILER_CACHE AND NOT CMAKE_CXX_COMPILER_LAUNCHER)\n";
+    ss << "    get_filename_component(JUCER_CACHE_ROOT \"" << root << "\" ABSOLUTE)\n";
+    ss << "    find_program(CCACHE_PROGRAM ccache)\n";
+    ss << "    find_program(SCCACHE_PROGRAM sccache)\n";
+    ss << "    if(CCACHE_PROGRAM)\n";
+    ss << "        execute_process(COMMAND ${CCACHE_PROGRAM} --version OUTPUT_VARIABLE JUCER_CCACHE_VERSION ERROR_QUIET)\n";
+    ss << "        string(REGEX MATCH \"[0-9]+\\\\.[0-9]+\" JUCER_CCACHE_VERSION \"${JUCER_CCACHE_VERSION}\")\n";
+    ss << "        if(JUCER_CCACHE_VERSION VERSION_LESS 4.8)\n";
+    ss << "            set(JUCER_LAUNCHER ${CCACHE_PROGRAM})\n";
+    ss << "            if(NOT DEFINED ENV{CCACHE_BASEDIR})\n";
+    ss << "                message(STATUS \"Set CCACHE_BASEDIR=${JUCER_CACHE_ROOT} for ccache ${JUCER_CCACHE_VERSION} to share cache entries between checkouts\")\n";
+    ss << "            endif()\n";
+    ss << "        else()\n";
+    ss << "            set(JUCER_LAUNCHER ${CCACHE_PROGRAM} base_dir=${JUCER_CACHE_ROOT} hash_dir=false";
+    if(opts.precompiledHeader)
+    {
+        ss << " sloppiness=pch_defines,time_macros,include_file_mtime,include_file_ctime";
+    }
+    ss << ")\n";
+    ss << "        endif()\n";
+    ss << "    elseif(SCCACHE_PROGRAM)\n";
+    ss << "        set(JUCER_LAUNCHER ${SCCACHE_PROGRAM})\n";
+    ss << "    endif()\n";
+    ss << "    if(JUCER_LAUNCHER)\n";
+    ss << "        set(CMAKE_C_COMPILER_LAUNCHER ${JUCER_LAUNCHER})\n";
+    ss << "        set(CMAKE_CXX_COMPILER_LAUNCHER ${JUCER_LAUNCHER})\n";
+    ss << "        message(STATUS \"Compiler Launcher ...... ${JUCER_LAUNCHER}\")\n";
+    ss << "    endif()\n";
+    ss << "\n";
+    ss << "    include(CheckCXXCompilerFlag)\n";
+    ss << "    check_cxx_compiler_flag(-ffile-prefix-map=a=b JUCER_HAS_FILE_PREFIX_MAP)\n";
+    ss << "    if(JUCER_HAS_FILE_PREFIX_MAP)\n";
+    ss << "        add_compile_options(\n";
+    ss << "            -ffile-prefix-map=${JUCER_CACHE_ROOT}/=\n";
+    ss << "            -ffile-prefix-map=${CMAKE_BINARY_DIR}/=\n";
+    ss << "        )\n";
+    ss << "    endif()\n";
+    ss << "endif()\n";
+    ss << "\n";
+    return ss.str();
+}
+
+/*
+ * Search paths are looked up in the sysroot.  With the compiler cache relative ones stay
+ * relative to the project, so that they are below the cache's base directory.
+ */
+std::string project::get_search_path(const std::string &path)
+{
+    if(!opts.compilerCache)
+    {
+        return "${CMAKE_SYSROOT}/" + path;
+    }
+    if(path.empty() || path[0] != '/')
+    {
+        return path;
+    }
+    return "${CMAKE_SYSROOT}" + path;
+}
+
 std::string project::get_cpp_standard()
 {
     if(cppLanguageStandard.empty())
@@ -532,102 +1723,167 @@ std::string project::get_executable()
         ss << "if(EXTERNAL_JUCE)\n";
         ss << "    add_dependencies(" << name << " juce_root)\n";
         ss << "endif()\n";
+        ss << "if(JUCER_MODULE_TARGETS)\n";
+        ss << "    target_link_libraries(" << name << " ${JUCER_MODULE_TARGETS})\n";
+        ss << "endif()\n";
+        ss << "if(BINARY_DATA_SOURCES)\n";
+        ss << "    target_sources(" << name << " PRIVATE ${BINARY_DATA_SOURCES})\n";
+        ss << "    target_include_directories(" << name << " PRIVATE ${BINARY_DATA_DIR})\n";
+        ss << "endif()\n";
         ss << "\n";
 
+        if(opts.unity)
+        {
+            // the include_*.cpp wrappers are amalgamations already and do not combine safely
+            ss << "if(JUCER_UNITY_BUILD AND NOT CMAKE_VERSION VERSION_LESS 3.16)\n";
+            ss << "    set_source_files_properties(${JUCE_LIBRARY_CODE_CPP} PROPERTIES SKIP_UNITY_BUILD_INCLUSION ON)\n";
+            ss << "    set_target_properties(" << name << " PROPERTIES UNITY_BUILD ON UNITY_BUILD_BATCH_SIZE ${UNITY_BATCH_SIZE})\n";
+            ss << "    if(NOT CMAKE_VERSION VERSION_LESS 3.18)\n";
+            ss << "        set_target_properties(" << name << " PROPERTIES UNITY_BUILD_MODE GROUP)\n";
+            ss << "    endif()\n";
+            ss << "endif()\n";
+            ss << "\n";
+        }
+
+        if(opts.precompiledHeader)
+        {
+            ss << get_precompiled_header();
+        }
+
         return ss.str();
     }
     return "";
 }
 
-std::string project::get_common_options()
+/*
+ * Precompiles JuceHeader.h, or when the project has none the module headers it would include.
+ * The include_*.cpp wrappers configure a module before including its header, so they are
+ * compiled without it.  Other targets can share the PCH with REUSE_FROM ${JUCER_PCH_TARGET}.
+ */
+std::string project::get_precompiled_header()
 {
-    std::stringstream ss;
-    ss << "if (CMAKE_CXX_COMPILER_ID MATCHES \"Clang\")\n";
-    ss << "    if(CMAKE_BUILD_TYPE STREQUAL \"Release\")\n";
-    ss << "        target_compile_options(" << name << " PUBLIC -flto)\n";
-    ss << "        target_link_options(" << name << " PUBLIC -flto)\n";
-    ss << "    elseif(CMAKE_BUILD_TYPE STREQUAL \"Debug\")\n";
-    ss << "        target_compile_options(" << name << " PUBLIC -fsanitize=address -fno-omit-frame-pointer)\n";
-    ss << "        target_link_options(" << name << " PUBLIC -fsanitize=address)\n";
-    ss << "    endif()\n";
-    ss << "endif()\n";
-    ss << "\n";
-    return ss.str();
-}
+    std::vector<std::string> headers;
 
-void project::get_export(std::string target, project::buildExport &build)
-{
-    std::string xpath = "/JUCERPROJECT/EXPORTFORMATS/" + target;
-    pugi::xpath_node_set set = m_Doc.select_nodes(xpath.c_str());
-
-    build.valid = false;
-    build.debug.valid = false;
-    build.release.valid = false;
-    
-    for (pugi::xpath_node_set::const_iterator it = set.begin(); it != set.end(); ++it)
+    struct stat info;
+    std::string code = base_path + sepd + "JuceLibraryCode" + sepd;
+    profiler::count(profiler::fsStat);
+    if(stat((code + "JuceHeader.h").c_str(), &info) == 0)
+    {
+        headers.push_back("${CMAKE_CURRENT_SOURCE_DIR}/JuceLibraryCode/JuceHeader.h");
+    }
+    else
     {
-        pugi::xpath_node node = *it;
-        build.targetFolder = node.node().attribute("targetFolder").value();
-        std::string _extraDefs = node.node().attribute("extraDefs").value();
-        if(!_extraDefs.empty())
+        profiler::count(profiler::fsStat);
+        if(stat((code + "AppConfig.h").c_str(), &info) == 0)
         {
-            build.extraDefs = utilities::split(_extraDefs, '\n');
+            headers.push_back("${CMAKE_CURRENT_SOURCE_DIR}/JuceLibraryCode/AppConfig.h");
         }
-        std::string _externalLibraries = node.node().attribute("externalLibraries").value();
-        if(!_externalLibraries.empty())
+        // only the modules that were found, ">" has to be escaped inside the generator expression
+        resolve_modules();
+        for(auto &m : juceModules)
         {
-            build.externalLibraries = utilities::split(_externalLibraries, '\n');
+            headers.push_back("<" + m.getID() + "/" + m.getID() + ".h$<ANGLE-R>");
         }
-        build.extraLinkerFlags = node.node().attribute("extraLinkerFlags").value();
-        build.cppLanguageStandard = node.node().attribute("cppLanguageStandard").value();
-        build.extraCompilerFlags = node.node().attribute("extraCompilerFlags").value();
-        build.valid = true;
     }
 
-    xpath = "/JUCERPROJECT/EXPORTFORMATS/" + target + "/CONFIGURATIONS/CONFIGURATION[@name='Debug']";
-    set = m_Doc.select_nodes(xpath.c_str());
+    if(headers.empty())
+    {
+        return "";
+    }
 
-    for (pugi::xpath_node_set::const_iterator it = set.begin(); it != set.end(); ++it)
+    std::stringstream ss;
+    ss << "option(JUCER_PRECOMPILE_HEADERS \"Precompile the JUCE headers\" ON)\n";
+    ss << "\n";
+    ss << "if(JUCER_PRECOMPILE_HEADERS AND NOT CMAKE_VERSION VERSION_LESS 3.16)\n";
+    ss << "    set(JUCER_PCH_TARGET " << name << ")\n";
+    ss << "    target_precompile_headers(" << name << " PRIVATE\n";
+    for(auto const& header : headers)
     {
-        pugi::xpath_node node = *it;
-        build.debug.name = node.node().attribute("name").as_string();
-        build.debug.isDebug = node.node().attribute("isDebug").as_bool();
-        build.debug.optimisation = node.node().attribute("optimisation").as_bool();
-        build.debug.targetName = node.node().attribute("targetName").as_string();
-        std::string _headerPath = node.node().attribute("headerPath").as_string();
-        if(!_headerPath.empty())
-        {
-            build.debug.headerPath = utilities::split(_headerPath, '\n');
-        }
-        std::string _libraryPath = node.node().attribute("libraryPath").as_string();
-        if(!_libraryPath.empty())
-        {
-            build.debug.libraryPath = utilities::split(_libraryPath, '\n');
-        }
-        build.debug.valid = true;
+        ss << "        \"$<$<COMPILE_LANGUAGE:CXX>:" << header << ">\"\n";
     }
+    ss << "    )\n";
+    ss << "    set_source_files_properties(${JUCE_LIBRARY_CODE_CPP} PROPERTIES SKIP_PRECOMPILE_HEADERS ON)\n";
+    ss << "endif()\n";
+    ss << "\n";
+
+    return ss.str();
+}
+
+/*
+ * Release builds use link time optimization when CheckIPOSupported says the toolchain can do it.
+ * Clang prefers ThinLTO with a cache in the build tree, so a relink only redoes the changed
+ * modules.  JUCER_LTO_MODE (auto, thin, full, off) and JUCER_LTO_JOBS are cache options.
+ * CMake's IPO flag for Clang is -flto=thin, so Clang gets its flags explicitly in either mode; the
+ * module libraries copy them with the compile options, the IPO property is set on them as well.
+ */
+std::string project::get_common_options()
+{
+    std::stringstream ss;
+    ss << "set(JUCER_LTO_MODE \"auto\" CACHE STRING \"Link time optimization of Release builds: auto, thin, full or off\")\n";
+    ss << "set_property(CACHE JUCER_LTO_MODE PROPERTY STRINGS auto thin full off)\n";
+    ss << "set(JUCER_LTO_JOBS \"0\" CACHE STRING \"Parallel LTO link jobs, 0 uses all cores\")\n";
+    ss << "\n";
+    ss << "if(NOT JUCER_LTO_MODE STREQUAL \"off\")\n";
+    ss << "    include(CheckIPOSupported)\n";
+    ss << "    check_ipo_supported(RESULT JUCER_IPO_SUPPORTED OUTPUT JUCER_IPO_OUTPUT LANGUAGES CXX)\n";
+    ss << "endif()\n";
+    ss << "\n";
+    ss << "if(JUCER_IPO_SUPPORTED AND NOT JUCER_LTO_MODE STREQUAL \"off\")\n";
+    ss << "    if(CMAKE_CXX_COMPILER_ID MATCHES \"Clang\" AND JUCER_LTO_MODE STREQUAL \"full\")\n";
+    ss << "        target_compile_options(" << name << " PRIVATE $<$<CONFIG:Release>:-flto=full>)\n";
+    ss << "        target_link_options(" << name << " PRIVATE $<$<CONFIG:Release>:-flto=full>)\n";
+    ss << "        message(STATUS \"LTO .................... full\")\n";
+    ss << "    elseif(CMAKE_CXX_COMPILER_ID MATCHES \"Clang\")\n";
+    ss << "        set(JUCER_LTO_CACHE ${CMAKE_BINARY_DIR}/lto.cache)\n";
+    ss << "        if(APPLE)\n";
+    ss << "            set(JUCER_LTO_LINK_OPTIONS -Wl,-cache_path_lto,${JUCER_LTO_CACHE})\n";
+    ss << "            set(JUCER_LTO_JOBS_OPTION -Wl,-mllvm,-threads=${JUCER_LTO_JOBS})\n";
+    ss << "        elseif(CMAKE_LINKER MATCHES \"lld\" OR CMAKE_EXE_LINKER_FLAGS MATCHES \"-fuse-ld=lld\" OR CMAKE_SHARED_LINKER_FLAGS MATCHES \"-fuse-ld=lld\")\n";
+    ss << "            set(JUCER_LTO_LINK_OPTIONS -Wl,--thinlto-cache-dir=${JUCER_LTO_CACHE})\n";
+    ss << "            set(JUCER_LTO_JOBS_OPTION -Wl,--thinlto-jobs=${JUCER_LTO_JOBS})\n";
+    ss << "        else()\n";
+    ss << "            set(JUCER_LTO_LINK_OPTIONS -Wl,-plugin-opt,cache-dir=${JUCER_LTO_CACHE})\n";
+    ss << "            set(JUCER_LTO_JOBS_OPTION -Wl,-plugin-opt,jobs=${JUCER_LTO_JOBS})\n";
+    ss << "        endif()\n";
+    ss << "        if(JUCER_LTO_JOBS GREATER 0)\n";
+    ss << "            list(APPEND JUCER_LTO_LINK_OPTIONS ${JUCER_LTO_JOBS_OPTION})\n";
+    ss << "        endif()\n";
+    ss << "        target_compile_options(" << name << " PRIVATE $<$<CONFIG:Release>:-flto=thin>)\n";
+    ss << "        target_link_options(" << name << " PRIVATE \"$<$<CONFIG:Release>:-flto=thin;${JUCER_LTO_LINK_OPTIONS}>\")\n";
+    ss << "        message(STATUS \"LTO .................... thin\")\n";
+    ss << "    else()\n";
+    ss << "        set_target_properties(" << name << " ${JUCER_MODULE_TARGETS} PROPERTIES INTERPROCEDURAL_OPTIMIZATION_RELEASE ON)\n";
+    ss << "        if(CMAKE_CXX_COMPILER_ID STREQUAL \"GNU\" AND JUCER_LTO_JOBS GREATER 0)\n";
+    ss << "            target_link_options(" << name << " PRIVATE $<$<CONFIG:Release>:-flto=${JUCER_LTO_JOBS}>)\n";
+    ss << "        endif()\n";
+    ss << "        message(STATUS \"LTO .................... full\")\n";
+    ss << "    endif()\n";
+    ss << "elseif(NOT JUCER_LTO_MODE STREQUAL \"off\")\n";
+    ss << "    message(STATUS \"LTO not supported: ${JUCER_IPO_OUTPUT}\")\n";
+    ss << "endif()\n";
+    ss << "\n";
+    ss << "if (CMAKE_CXX_COMPILER_ID MATCHES \"Clang\")\n";
+    ss << "    if(CMAKE_BUILD_TYPE STREQUAL \"Debug\")\n";
+    ss << "        target_compile_options(" << name << " PUBLIC -fsanitize=address -fno-omit-frame-pointer)\n";
+    ss << "        target_link_options(" << name << " PUBLIC -fsanitize=address)\n";
+    ss << "    endif()\n";
+    ss << "endif()\n";
+    ss << "\n";
+    return ss.str();
+}
 
-    xpath = "/JUCERPROJECT/EXPORTFORMATS/" + target + "/CONFIGURATIONS/CONFIGURATION[@name='Release']";
-    set = m_Doc.select_nodes(xpath.c_str());
+void project::get_export(std::string target, project::buildExport &build)
+{
+    build.valid = false;
+    build.debug.valid = false;
+    build.release.valid = false;
 
-    for (pugi::xpath_node_set::const_iterator it = set.begin(); it != set.end(); ++it)
+    for (auto const& e : exporters)
     {
-        pugi::xpath_node node = *it;
-        build.release.name = node.node().attribute("name").as_string();
-        build.release.isDebug = node.node().attribute("isDebug").as_bool();
-        build.release.optimisation = node.node().attribute("optimisation").as_bool();
-        build.release.targetName = node.node().attribute("targetName").as_string();
-        std::string _headerPath = node.node().attribute("headerPath").as_string();
-        if(!_headerPath.empty())
-        {
-            build.release.headerPath = utilities::split(_headerPath, '\n');
-        }
-        std::string _libraryPath = node.node().attribute("libraryPath").as_string();
-        if(!_libraryPath.empty())
+        if (e.format == target)
         {
-            build.release.libraryPath = utilities::split(_libraryPath, '\n');
+            build = e;
         }
-        build.release.valid = true;
     }
 }
 
@@ -641,14 +1897,14 @@ std::string project::get_apple_ios_config()
     {
         return "";
     }
-    std::cout << "Using iOS Config" << std::endl;
+    report({ diagnostic::note, "Using iOS Config", jucer_file, 0, -1 });
 
     if(!b.debug.headerPath.empty())
     {
         ss << "            target_include_directories(" << name << " PUBLIC\n";
         for(auto const& path : b.debug.headerPath)
         {
-            ss << "                ${CMAKE_SYSROOT}/" << path << "\n";
+            ss << "                " << get_search_path(path) << "\n";
         }
         ss << "            )\n";
         ss << "\n";
@@ -665,14 +1921,14 @@ std::string project::get_apple_ios_config()
         ss << "            target_link_directories(" << name << " BEFORE PUBLIC\n";
         for(auto const& path : b.debug.libraryPath)
         {
-            ss << "                ${CMAKE_SYSROOT}/" << path << "\n";
+            ss << "                " << get_search_path(path) << "\n";
         }
         ss << "            )\n";
         ss << "\n";
     }
 
     int count = 0;
-    for(auto const& framework : get_libraries(iOSFrameworks))
+    for(auto const& framework : get_libraries(iOSFrameworks, &module::getiOSFrameworks))
     {
         ss << "            find_library(FRAMEWORK" << count++ << " " << framework << ")\n";
     }
@@ -701,14 +1957,14 @@ std::string project::get_apple_osx_config()
     {
         return "";
     }
-    std::cout << "Using XCode Config" << std::endl;
+    report({ diagnostic::note, "Using XCode Config", jucer_file, 0, -1 });
 
     if(!b.debug.headerPath.empty())
     {
         ss << "            target_include_directories(" << name << " PUBLIC\n";
         for(auto const& path : b.debug.headerPath)
         {
-            ss << "                ${CMAKE_SYSROOT}/" << path << "\n";
+            ss << "                " << get_search_path(path) << "\n";
         }
         ss << "            )\n";
         ss << "\n";
@@ -725,14 +1981,14 @@ std::string project::get_apple_osx_config()
         ss << "            target_link_directories(" << name << " BEFORE PUBLIC\n";
         for(auto const& path : b.debug.libraryPath)
         {
-            ss << "                ${CMAKE_SYSROOT}/" << path << "\n";
+            ss << "                " << get_search_path(path) << "\n";
         }
         ss << "            )\n";
         ss << "\n";
     }
 
     int count = 0;
-    for(auto const& framework : get_libraries(OSXFramework))
+    for(auto const& framework : get_libraries(OSXFramework, &module::getOSXFrameworks))
     {
         ss << "            find_library(FRAMEWORK" << count++ << " " << framework << ")\n";
     }
@@ -761,9 +2017,9 @@ std::string project::get_linux_config()
     {
         return "";
     }
-    std::cout << "Using Linux Config" << std::endl;
+    report({ diagnostic::note, "Using Linux Config", jucer_file, 0, -1 });
 
-    auto packages = get_libraries(linuxPackages);
+    auto packages = get_libraries(linuxPackages, &module::getLinuxPackages);
     if(!packages.empty())
     {
         ss << "\n";
@@ -786,7 +2042,7 @@ std::string project::get_linux_config()
         }
         for(auto const& path : b.debug.headerPath)
         {
-            ss << "            ${CMAKE_SYSROOT}/" << path << "\n";
+            ss << "            " << get_search_path(path) << "\n";
         }
         ss << "        )\n";
     }
@@ -801,12 +2057,12 @@ std::string project::get_linux_config()
         ss << "        target_link_directories(" << name << " BEFORE PUBLIC\n";
         for(auto const& path : b.debug.libraryPath)
         {
-            ss << "            ${CMAKE_SYSROOT}/" << path << "\n";
+            ss << "            " << get_search_path(path) << "\n";
         }
         ss << "        )\n";
     }
 
-    auto libs = get_libraries(linuxLibs);
+    auto libs = get_libraries(linuxLibs, &module::getLinuxLibs);
     if(!b.externalLibraries.empty() || !packages.empty() || !libs.empty())
     {
         ss << "\n";
@@ -822,7 +2078,7 @@ std::string project::get_linux_config()
         if(!libs.empty())
         {
             ss << "            ";
-            for(auto const& lib : get_libraries(linuxLibs))
+            for(auto const& lib : libs)
             {
                 ss << lib << " ";
             }
@@ -849,7 +2105,7 @@ std::string project::get_msvc_config()
             get_export("VS2015", b);
             if(b.valid)
             {
-                std::cout << "Using VS2015 Config" << std::endl;
+                report({ diagnostic::note, "Using VS2015 Config", jucer_file, 0, -1 });
             }
             else
             {
@@ -859,12 +2115,12 @@ std::string project::get_msvc_config()
         }
         else
         {
-            std::cout << "Using VS2017 Config" << std::endl;
+            report({ diagnostic::note, "Using VS2017 Config", jucer_file, 0, -1 });
         }
     }
     else
     {
-        std::cout << "Using VS2019 Config" << std::endl;
+        report({ diagnostic::note, "Using VS2019 Config", jucer_file, 0, -1 });
     }
     
     if(!b.debug.headerPath.empty())
@@ -873,7 +2129,7 @@ std::string project::get_msvc_config()
         ss << "    target_include_directories(" << name << " PUBLIC\n";
         for(auto const& path : b.debug.headerPath)
         {
-            ss << "        \"${CMAKE_SYSROOT}/" << path << "\"\n";
+            ss << "        \"" << get_search_path(path) << "\"\n";
         }
         ss << "    )\n";
         ss << "\n";
@@ -898,7 +2154,7 @@ std::string project::get_msvc_config()
         ss << "    target_link_directories(" << name << " BEFORE PUBLIC\n";
         for(auto const& path : b.debug.libraryPath)
         {
-            ss << "        \"${CMAKE_SYSROOT}/" << path << "\"\n";
+            ss << "        \"" << get_search_path(path) << "\"\n";
         }
         ss << "    )\n";
     }
@@ -944,27 +2200,885 @@ std::string project::get_cmake_file()
     return path;
 }
 
-void project::gen_cmake()
+std::string project::get_stamp_file()
+{
+    std::string sepd = (base_path.find("\\") != std::string::npos) ? "\\" : "/";
+    std::string path = output_path + sepd + ".jucer2cmake.stamp";
+    return path;
+}
+
+std::vector<std::string> project::get_module_headers()
+{
+    resolve_modules();
+
+    std::vector<std::string> res;
+    for(auto &m : juceModules)
+    {
+        res.push_back(m.getHeader());
+    }
+
+    return res;
+}
+
+/* files whose size, or absence, is part of the input hash */
+std::vector<std::string> project::get_sized_files()
+{
+    std::vector<std::string> res;
+    for (auto const& group : mainGroup.groups)
+    {
+        if (group.name == "Resources")
+        {
+            for (auto const& index : group.files)
+            {
+                res.push_back(files[index].file);
+            }
+        }
+    }
+    if (opts.compressResources && !res.empty())
+    {
+        // compressing is refused while the Projucer's BinaryData.h exists
+        res.push_back("JuceLibraryCode/BinaryData.h");
+    }
+    if (opts.precompiledHeader)
+    {
+        // the precompiled header is JuceHeader.h, or AppConfig.h and the modules without it
+        res.push_back("JuceLibraryCode/JuceHeader.h");
+        res.push_back("JuceLibraryCode/AppConfig.h");
+    }
+    if (opts.unity)
+    {
+        for (auto const& f : files)
+        {
+            if (f.compile)
+            {
+                res.push_back(f.file);
+            }
+        }
+    }
+    return res;
+}
+
+/* project relative paths of the files in the groups, in project order */
+std::vector<std::string> project::get_source_files()
+{
+    std::vector<std::string> res;
+    for (auto const& f : files)
+    {
+        res.push_back(f.file);
+    }
+    return res;
+}
+
+/* (id, header) of the modules of the project, the header is empty when the module was not found */
+std::vector<std::pair<std::string, std::string>> project::get_resolved_modules()
+{
+    resolve_modules();
+
+    std::vector<std::pair<std::string, std::string>> res;
+    for (auto const& id : modules)
+    {
+        std::string header;
+        for (auto &m : juceModules)
+        {
+            if (m.getID() == id)
+            {
+                header = m.getHeader();
+                break;
+            }
+        }
+        res.push_back({ id, header });
+    }
+    return res;
+}
+
+/* what --watch has to watch: files the output depends on and folders whose listing it depends on */
+void project::get_watch_paths(std::vector<std::string> &paths, std::vector<std::string> &folders)
+{
+    paths.push_back(jucer_file);
+    for (auto const& header : get_module_headers())
+    {
+        paths.push_back(header);
+    }
+    for (auto const& file : get_sized_files())
+    {
+        paths.push_back(base_path + sepd + file);
+    }
+    folders.push_back(base_path + sepd + "JuceLibraryCode");
+}
+
+/* the options that change the generated output, as part of the input hash */
+std::string project::get_options_key()
+{
+    std::stringstream ss;
+    ss << "unity=" << opts.unity << "," << opts.unityBatchSize;
+    for(auto const& pattern : opts.unityExclude)
+    {
+        ss << "," << pattern;
+    }
+    ss << " pch=" << opts.precompiledHeader;
+    ss << " cache=" << opts.compilerCache;
+    ss << " embed=" << opts.embedShardSize;
+    ss << " compress=" << opts.compressResources;
+    for(auto const& pattern : opts.compressExclude)
+    {
+        ss << "," << pattern;
+    }
+    ss << "\n";
+    return ss.str();
+}
+
+/* Hash of everything the generated file is derived from: the generator version and options, the .jucer, file sizes and the module headers */
+std::string project::get_input_hash()
+{
+    profiler::scope s("input hash");
+    std::string contents = J2C_VERSION + get_options_key();
+    uint64_t h = utilities::hash(contents.data(), contents.size());
+    h = utilities::hash(reinterpret_cast<const char*>(&jucer_hash), sizeof(jucer_hash), h);
+
+    // JuceLibraryCode files are listed in the output
+    std::vector<std::string> cpp;
+    std::vector<std::string> mm;
+    get_library_code(cpp, mm);
+    for(auto const& file : cpp)
+    {
+        h = utilities::hash(file.data(), file.size(), h);
+    }
+    for(auto const& file : mm)
+    {
+        h = utilities::hash(file.data(), file.size(), h);
+    }
+
+    for(auto const& file : get_sized_files())
+    {
+        struct stat info;
+        profiler::count(profiler::fsStat);
+        int64_t size = (stat((base_path + sepd + file).c_str(), &info) == 0) ? info.st_size : -1;
+        h = utilities::hash(file.data(), file.size(), h);
+        h = utilities::hash(reinterpret_cast<const char*>(&size), sizeof(size), h);
+    }
+
+    // header mtimes stand in for their content
+    for(auto const& header : get_module_headers())
+    {
+        int64_t mtime = utilities::getModifiedTime(header);
+        h = utilities::hash(header.data(), header.size(), h);
+        h = utilities::hash(reinterpret_cast<const char*>(&mtime), sizeof(mtime), h);
+    }
+
+    return utilities::toHex(h);
+}
+
+std::string project::get_cmake()
+{
+    std::string res;
+    get_cmake([&res](const char *data, size_t length)
+    {
+        res.append(data, length);
+    });
+    return res;
+}
+
+/* the output section by section, so that library users can stream it */
+void project::get_cmake(const writer &write)
+{
+    auto section = [this, &write](const char *name, std::string (project::*emitter)())
+    {
+        std::string text;
+        {
+            profiler::scope s(name);
+            text = (this->*emitter)();
+        }
+        write(text.data(), text.size());
+    };
+
+    section("get_header", &project::get_header);
+    section("get_dependencies", &project::get_dependencies);
+    section("get_cpp_standard", &project::get_cpp_standard);
+    if(opts.compilerCache)
+    {
+        section("get_compiler_cache", &project::get_compiler_cache);
+    }
+    section("get_defines", &project::get_defines);
+    section("get_include_dirs", &project::get_include_dirs);
+    section("get_autogen_vars", &project::get_autogen_vars);
+    section("get_resource_files", &project::get_resource_files);
+    section("get_source_list", &project::get_source_list);
+    section("get_module_libraries", &project::get_module_libraries);
+    //section("get_source_groups", &project::get_source_groups);
+    section("get_executable", &project::get_executable);
+    section("get_common_options", &project::get_common_options);
+    section("get_target_config", &project::get_target_config);
+}
+
+/*
+ * Regenerates CMakeLists.txt, returns true if its content changed (or would change when check is set).
+ * The file is only replaced when the rendered text differs, so its mtime does not trigger a reconfigure.
+ * The stamp records the input hash and the hash of the file written, when both still match nothing is rendered.
+ */
+bool project::gen_cmake(bool check)
+{
+    std::string cmake_file = get_cmake_file();
+    std::string stamp_file = get_stamp_file();
+
+    std::string current;
+    bool exists;
+    {
+        profiler::scope s("output read");
+        exists = utilities::readFile(cmake_file, current);
+    }
+
+    std::string inputs = get_input_hash();
+    std::string stamp;
+    if(exists && utilities::readFile(stamp_file, stamp))
+    {
+        if(stamp == inputs + " " + utilities::toHex(utilities::hash(current.data(), current.size())) + "\n")
+        {
+            return false;
+        }
+    }
+
+    std::string content = get_cmake();
+    bool changed = !exists || (content != current);
+
+    if(!check)
+    {
+        profiler::scope s("file write");
+        if(changed && !utilities::writeFileAtomic(cmake_file, content))
+        {
+            throw std::runtime_error("Error writing file: " + cmake_file);
+        }
+        if(!utilities::writeFileAtomic(stamp_file, inputs + " " + utilities::toHex(utilities::hash(content.data(), content.size())) + "\n"))
+        {
+            report({ diagnostic::warning, "Error writing file: " + stamp_file + ", every run renders the output again", jucer_file, 0, -1 });
+        }
+    }
+
+    return changed;
+}
+
+bool project::generate(bool check)
+{
+    return opts.ninja ? gen_ninja(check) : gen_cmake(check);
+}
+
+std::string project::get_output_file()
+{
+    return opts.ninja ? get_ninja_file() : get_cmake_file();
+}
+
+std::string project::get_ninja_file()
+{
+    std::string sepd = (base_path.find("\\") != std::string::npos) ? "\\" : "/";
+    std::string path = output_path + sepd + "build.ninja";
+    return path;
+}
+
+/* ninja treats $, space and colon in paths and variables as syntax */
+static std::string ninja_escape(const std::string &s)
+{
+    std::string res;
+    for (char c : s)
+    {
+        if (c == '$' || c == ' ' || c == ':')
+        {
+            res += '$';
+        }
+        res += c;
+    }
+    return res;
+}
+
+/* a variable value, where only $ is syntax */
+static std::string ninja_value(const std::string &s)
+{
+    std::string res;
+    for (char c : s)
+    {
+        if (c == '$')
+        {
+            res += '$';
+        }
+        res += c;
+    }
+    return res;
+}
+
+/* one argument of a command line, quoted when the shell would split or expand it */
+static std::string shell_quote(const std::string &s)
+{
+    if (!s.empty() && s.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-+=.,/:@%") == std::string::npos)
+    {
+        return s;
+    }
+    std::string res = "'";
+    for (char c : s)
+    {
+        if (c == '\'')
+        {
+            res += "'\\''";
+        }
+        else
+        {
+            res += c;
+        }
+    }
+    return res + "'";
+}
+
+/*
+ * The toolchain file has one `name = value` per line, `#` starts a comment.  cc, cxx, cflags,
+ * cxxflags, ldflags, debug_flags and release_flags are written to build.ninja as they are, ninja
+ * variable values of shell words (cxx may be "ccache clang++", $root is the project folder).  sysroot prefixes the absolute exporter search paths
+ * and is passed to pkg-config, pkg_config selects the pkg-config program.
+ */
+void project::get_toolchain(project::ninjaToolchain &t)
+{
+    t.cc = "cc";
+    t.cxx = "c++";
+    t.debugFlags = "-g";
+    t.releaseFlags = "-O3 -DNDEBUG";
+    t.pkgConfig = "pkg-config";
+
+    if(opts.toolchain.empty())
+    {
+        return;
+    }
+
+    std::string text;
+    if(!utilities::readFile(opts.toolchain, text))
+    {
+        throw std::runtime_error("Error opening toolchain file: " + opts.toolchain);
+    }
+
+    const std::map<std::string, std::string ninjaToolchain::*> settings = {
+        { "cc", &ninjaToolchain::cc },
+        { "cxx", &ninjaToolchain::cxx },
+        { "cflags", &ninjaToolchain::cflags },
+        { "cxxflags", &ninjaToolchain::cxxflags },
+        { "ldflags", &ninjaToolchain::ldflags },
+        { "debug_flags", &ninjaToolchain::debugFlags },
+        { "release_flags", &ninjaToolchain::releaseFlags },
+        { "sysroot", &ninjaToolchain::sysroot },
+        { "pkg_config", &ninjaToolchain::pkgConfig },
+    };
+
+    long line = 0;
+    for(auto const& entry : utilities::split(text, '\n'))
+    {
+        line++;
+        auto setting = utilities::trim(entry);
+        if(setting.empty() || setting[0] == '#')
+        {
+            continue;
+        }
+        size_t eq = setting.find('=');
+        std::string key(utilities::trim(setting.substr(0, std::min(eq, setting.size()))));
+        auto it = settings.find(key);
+        if(eq == std::string_view::npos || it == settings.end())
+        {
+            report({ diagnostic::warning, "Unknown toolchain setting: " + std::string(setting), opts.toolchain, line, -1 });
+            continue;
+        }
+        t.*(it->second) = std::string(utilities::trim(setting.substr(eq + 1)));
+    }
+}
+
+/* the pkg-config command line printing the --cflags or --libs of the packages */
+std::string project::get_pkg_config(const project::ninjaToolchain &t, const std::list<std::string> &packages, const char *query)
+{
+    std::string command;
+    if(!t.sysroot.empty())
+    {
+        command += "PKG_CONFIG_SYSROOT_DIR=" + shell_quote(t.sysroot) + " ";
+    }
+    command += t.pkgConfig + " " + query;
+    for(auto const& package : packages)
+    {
+        command += " " + shell_quote(package);
+    }
+    return command;
+}
+
+/*
+ * build.ninja for the Linux exporter, written straight from the project so that a build needs
+ * no CMake configure step.  The compiler comes from the toolchain file, nothing is probed.  The
+ * pkg-config packages of the modules are queried by every build into flag files the compiler
+ * reads (@file), which are only replaced when the flags change, e.g. after a package upgrade.
+ * Every source is compiled for Release and Debug into $builddir/<config>, `release` is the
+ * default target.
+ * The resources are embedded as in the CMake output, the BinaryData index is written now.
+ */
+std::string project::get_ninja()
+{
+    if(name.empty())
+    {
+        throw std::runtime_error("The project has no name: " + jucer_file);
+    }
+
+    ninjaToolchain t;
+    get_toolchain(t);
+
+    project::buildExport b;
+    get_export("LINUX_MAKE", b);
+    if(b.valid)
+    {
+        report({ diagnostic::note, "Using Linux Config", jucer_file, 0, -1 });
+    }
+    else
+    {
+        report({ diagnostic::warning, "No Linux exporter, building without its settings", jucer_file, 0, -1 });
+    }
+    if(opts.unity || opts.precompiledHeader || opts.compilerCache)
+    {
+        report({ diagnostic::note, "Unity builds, precompiled headers and the compiler cache option only apply to CMake, set cxx in the toolchain file for a launcher", jucer_file, 0, -1 });
+    }
+
+    char resolved[PATH_MAX];
+    if(!realpath(base_path.c_str(), resolved))
+    {
+        throw std::runtime_error("Error resolving path: " + base_path);
+    }
+    std::string root = resolved;
+
+    // project relative paths are written below $root, so build.ninja may live in another folder.
+    // Build lines take escaped paths, commands get shell words: ninja quotes $in and $out only
+    auto source = [](const std::string &path)
+    {
+        return (!path.empty() && path[0] == '/') ? ninja_escape(path) : "$root/" + ninja_escape(path);
+    };
+    auto argument = [&root](const std::string &option, const std::string &path)
+    {
+        return ninja_value(shell_quote(option + ((!path.empty() && path[0] == '/') ? path : root + "/" + path)));
+    };
+    auto search = [&](const std::string &option, const std::string &path)
+    {
+        return (!path.empty() && path[0] == '/') ? ninja_value(shell_quote(option + t.sysroot + path)) : argument(option, path);
+    };
+
+    std::stringstream includes;
+    includes << argument("-I", "JuceLibraryCode");
+    for(auto const& path : get_module_path_list())
+    {
+        struct stat info;
+        std::string pathname = (path[0] == '/') ? path : base_path + sepd + path;
+        profiler::count(profiler::fsStat);
+        if(stat(pathname.c_str(), &info) != 0)
+        {
+            report({ diagnostic::error, "Path not present: " + pathname, jucer_file, 0, -1 });
+            throw std::runtime_error("The JUCE modules are not present, the Ninja output does not download them: " + pathname);
+        }
+        includes << " " << argument("-I", path);
+    }
+    for(auto const& path : headerPath)
+    {
+        includes << " " << argument("-I", path);
+    }
+    for(auto const& path : b.debug.headerPath)
+    {
+        includes << " " << search("-I", path);
+    }
+
+    std::stringstream flags;
+    std::stringstream libs;
+    std::list<std::string> packages;
+    if(b.valid)
+    {
+        flags << ninja_value(b.extraCompilerFlags);
+
+        packages = get_libraries(linuxPackages, &module::getLinuxPackages);
+        if(!packages.empty())
+        {
+            flags << " @$builddir/pkg-config.cflags";
+        }
+        for(auto const& path : b.debug.libraryPath)
+        {
+            libs << " " << search("-L", path);
+        }
+        for(auto const& library : b.externalLibraries)
+        {
+            if(library[0] == '-')
+            {
+                libs << " " << ninja_value(library);
+            }
+            else
+            {
+                libs << " " << ((library.find('/') != std::string::npos) ? argument("", library) : ninja_value(shell_quote("-l" + library)));
+            }
+        }
+        if(!packages.empty())
+        {
+            libs << " @$builddir/pkg-config.libs";
+        }
+        for(auto const& lib : get_libraries(linuxLibs, &module::getLinuxLibs))
+        {
+            libs << " -l" << lib;
+        }
+    }
+
+    bool shared = (projectType == "audioplug" || projectType == "dll" || projectType == "library");
+    if(shared)
+    {
+        flags << " -fPIC";
+    }
+
+    std::stringstream defs;
+    std::string list = defines;
+    std::replace_if(list.begin(), list.end(), [](char c) { return isspace(static_cast<unsigned char>(c)); }, ' ');
+    for(auto const& def : utilities::split(list, ' '))
+    {
+        if(!def.empty())
+        {
+            defs << "-D" << ninja_value(shell_quote(std::string(def))) << " ";
+        }
+    }
+    for(auto const& def : get_definitions())
+    {
+        defs << "-D" << def << " ";
+    }
+
+    resourceData data;
+    get_resource_data(data);
+    if(!data.files.empty() && opts.generator.empty())
+    {
+        throw std::runtime_error("The Ninja output embeds resources with jucer2cmake --embed, the generator path is not set");
+    }
+
+    std::vector<std::string> cpp;
+    std::vector<std::string> mm;
+    get_library_code(cpp, mm);
+    if(!data.files.empty())
+    {
+        cpp.erase(std::remove(cpp.begin(), cpp.end(), "JuceLibraryCode/BinaryData.cpp"), cpp.end());
+    }
+
+    // sources as (ninja path, object name below $builddir/<config>, rule)
+    struct object
+    {
+        std::string path;
+        std::string name;
+        const char *rule;
+    };
+    std::vector<object> objects;
+    auto add = [&objects](const std::string &path, std::string name)
+    {
+        size_t dot = path.find_last_of('.');
+        std::string ext = (dot == std::string::npos) ? "" : path.substr(dot);
+        const char *rule = (ext == ".c") ? "cc" : (ext == ".cpp" || ext == ".cc" || ext == ".cxx" || ext == ".c++") ? "cxx" : nullptr;
+        if(rule)
+        {
+            for(size_t up; (up = name.find("../")) != std::string::npos; )
+            {
+                name.replace(up, 3, "__/");
+            }
+            name.erase(0, name.find_first_not_of('/'));
+            objects.push_back({ path, ninja_escape(name) + ".o", rule });
+        }
+    };
+    for(auto const& f : files)
+    {
+        if(f.compile)
+        {
+            add(source(f.file), f.file);
+        }
+    }
+    for(auto const& file : cpp)
+    {
+        add(source(file), file);
+    }
+
+    std::stringstream ss;
+    ss << "# build.ninja written by jucer2cmake from " << jucer_file.substr(jucer_file.find_last_of("\\/") + 1) << ", regenerate it instead of editing\n";
+    ss << "#\n";
+    // the path as the regenerate rule passes it, so that its run writes the same file
+    char folder[PATH_MAX];
+    ss << "#   ninja -C " << (realpath(output_path.c_str(), folder) ? folder : output_path.c_str()) << " [release|debug|all]\n";
+    ss << "\n";
+    ss << "ninja_required_version = 1.3\n";
+    ss << "\n";
+    auto variable = [&ss](const char *name, const std::string &value)
+    {
+        ss << name << " =" << (value.empty() ? "" : " ") << utilities::trim(value) << "\n";
+    };
+    variable("root", ninja_escape(root));
+    variable("builddir", "build-ninja");
+    ss << "\n";
+    variable("cc", t.cc);
+    variable("cxx", t.cxx);
+    variable("cflags", t.cflags);
+    variable("cxxflags", t.cxxflags);
+    variable("ldflags", t.ldflags);
+    variable("debug_flags", t.debugFlags);
+    variable("release_flags", t.releaseFlags);
+    if(!t.sysroot.empty())
+    {
+        variable("sysroot", "--sysroot=" + ninja_value(shell_quote(t.sysroot)));
+    }
+    ss << "\n";
+    variable("cxx_standard", "-std=c++" + (cppLanguageStandard.empty() ? std::string("11") : cppLanguageStandard));
+    variable("defines", defs.str());
+    variable("includes", includes.str() + (data.files.empty() ? "" : " -I$builddir/BinaryData"));
+    variable("project_flags", flags.str());
+    variable("libs", libs.str());
+    if(!data.files.empty())
+    {
+        variable("generator", ninja_escape(opts.generator));
+    }
+    ss << "\n";
+
+    const char *configs[] = { "Release", "Debug" };
+    for(auto config : configs)
+    {
+        std::string suffix = (config[0] == 'R') ? "release" : "debug";
+        std::string configFlags = "$" + suffix + "_flags";
+        ss << "rule cxx_" << suffix << "\n";
+        ss << "  command = $cxx -MD -MF $out.d $cxx_standard $defines $includes $project_flags " << configFlags << " $sysroot $cxxflags -c $in -o $out\n";
+        ss << "  depfile = $out.d\n";
+        ss << "  deps = gcc\n";
+        ss << "  description = CXX " << config << " $in\n";
+        ss << "\n";
+        ss << "rule cc_" << suffix << "\n";
+        ss << "  command = $cc -MD -MF $out.d $defines $includes $project_flags " << configFlags << " $sysroot $cflags -c $in -o $out\n";
+        ss << "  depfile = $out.d\n";
+        ss << "  deps = gcc\n";
+        ss << "  description = CC " << config << " $in\n";
+        ss << "\n";
+        ss << "rule link_" << suffix << "\n";
+        ss << "  command = $cxx" << (shared ? " -shared" : "") << " " << configFlags << " $sysroot $ldflags -o $out $in $libs\n";
+        ss << "  description = LINK " << config << " $out\n";
+        ss << "\n";
+    }
+
+    // run on every build (the phony input never exists), restat keeps the objects when nothing changed
+    std::string compileDeps;
+    std::string linkDeps;
+    if(!packages.empty())
+    {
+        ss << "rule pkg_config\n";
+        ss << "  command = $pkg_config > $out.tmp && if cmp -s $out.tmp $out; then rm $out.tmp; else mv $out.tmp $out; fi\n";
+        ss << "  description = PKG-CONFIG $out\n";
+        ss << "  restat = 1\n";
+        ss << "\n";
+        ss << "build $builddir/pkg-config.cflags: pkg_config | $builddir/pkg-config.always\n";
+        ss << "  pkg_config = " << ninja_value(get_pkg_config(t, packages, "--cflags")) << "\n";
+        ss << "build $builddir/pkg-config.libs: pkg_config | $builddir/pkg-config.always\n";
+        ss << "  pkg_config = " << ninja_value(get_pkg_config(t, packages, "--libs")) << "\n";
+        ss << "build $builddir/pkg-config.always: phony\n";
+        ss << "\n";
+        compileDeps = " | $builddir/pkg-config.cflags";
+        linkDeps = " | $builddir/pkg-config.libs";
+    }
+
+    if(!data.files.empty())
+    {
+        ss << "rule embed\n";
+        ss << "  command = " << ninja_value(shell_quote(opts.generator)) << " --embed $out $resources\n";
+        ss << "  description = EMBED $out\n";
+        ss << "\n";
+
+        objects.push_back({ "$builddir/BinaryData/BinaryData.cpp", "BinaryData/BinaryData.cpp.o", "cxx" });
+        for(size_t k = 0; k < data.shards.size(); k++)
+        {
+            std::string shard = "BinaryData/BinaryData_" + std::to_string(k + 1) + ".cpp";
+            ss << "build $builddir/" << shard << ": embed";
+            for(auto const& piece : data.shards[k])
+            {
+                ss << " " << source(data.files[piece.file]);
+            }
+            ss << " | $generator\n";
+            ss << "  resources =";
+            for(auto const& piece : data.shards[k])
+            {
+                auto const& file = data.files[piece.file];
+                std::string path = (file[0] == '/') ? file : root + "/" + file;
+                ss << " " << get_embed_argument(data, piece) << "=" << ninja_value(shell_quote(path));
+            }
+            ss << "\n";
+            objects.push_back({ "$builddir/" + shard, shard + ".o", "cxx" });
+        }
+        ss << "\n";
+    }
+
+    std::string target = shared ? "lib" + name + ".so" : name;
+    for(auto config : configs)
+    {
+        std::string suffix = (config[0] == 'R') ? "release" : "debug";
+        std::string dir = std::string("$builddir/") + config + "/";
+        for(auto const& o : objects)
+        {
+            ss << "build " << dir << o.name << ": " << o.rule << "_" << suffix << " " << o.path << compileDeps << "\n";
+        }
+        ss << "\n";
+        ss << "build " << dir << ninja_escape(target) << ": link_" << suffix;
+        for(auto const& o : objects)
+        {
+            ss << " $\n    " << dir << o.name;
+        }
+        ss << linkDeps << "\n";
+        ss << "build " << suffix << ": phony " << dir << ninja_escape(target) << "\n";
+        ss << "\n";
+    }
+    ss << "build all: phony release debug\n";
+    ss << "default release\n";
+
+    if(!opts.generator.empty())
+    {
+        std::vector<std::string> generated;
+        if(!data.files.empty())
+        {
+            generated = { "$builddir/BinaryData/BinaryData.h", "$builddir/BinaryData/BinaryData.cpp" };
+            if(opts.compressResources)
+            {
+                generated.push_back("$builddir/BinaryData/BinaryDataDecoder.h");
+            }
+        }
+        ss << "\n";
+        ss << get_ninja_regenerate(generated);
+    }
+
+    return ss.str();
+}
+
+/*
+ * Reruns jucer2cmake when the .jucer, the toolchain file or the files --watch follows change.
+ * Only existing files are inputs, ninja fails on a missing one it has no rule for.  build.ninja
+ * keeps its mtime when the output does not change, restat stops ninja from rerunning it then.
+ * The files gen_ninja writes next to it are outputs as well, so a deleted build folder reruns it.
+ */
+std::string project::get_ninja_regenerate(const std::vector<std::string> &generated)
 {
-    std::ofstream outfile (get_cmake_file(), std::ofstream::binary);
+    std::vector<std::string> paths;
+    std::vector<std::string> folders;
+    get_watch_paths(paths, folders);
+    paths.insert(paths.end(), folders.begin(), folders.end());
+    if(!opts.toolchain.empty())
+    {
+        paths.push_back(opts.toolchain);
+    }
+    paths.push_back(opts.generator);
 
-    outfile << get_header();
-    outfile << get_dependencies();
-    outfile << get_cpp_standard();
-    outfile << get_defines();
-    outfile << get_include_dirs();
-    outfile << get_autogen_vars();
-    outfile << get_resource_files();
-    outfile << get_source_list();
-    //outfile << get_source_groups();
-    outfile << get_executable();
-    outfile << get_common_options();
-    outfile << get_target_config();
+    auto absolute = [](const std::string &path)
+    {
+        char resolved[PATH_MAX];
+        return realpath(path.c_str(), resolved) ? std::string(resolved) : std::string();
+    };
 
-    outfile.close();
+    std::string command = shell_quote(opts.generator) + " --ninja";
+    if(!opts.toolchain.empty())
+    {
+        command += " --toolchain " + shell_quote(absolute(opts.toolchain));
+    }
+    if(opts.compressResources)
+    {
+        command += " --compress-resources";
+        auto defaults = options().compressExclude;
+        for(auto const& pattern : opts.compressExclude)
+        {
+            if(std::find(defaults.begin(), defaults.end(), pattern) == defaults.end())
+            {
+                command += " --compress-exclude " + shell_quote(pattern);
+            }
+        }
+    }
+    if(opts.embedShardSize != options().embedShardSize)
+    {
+        command += " --embed-shard-size " + std::to_string(opts.embedShardSize / 1024);
+    }
+    command += " -o " + shell_quote(absolute(output_path)) + " " + shell_quote(absolute(jucer_file));
+
+    std::stringstream ss;
+    ss << "rule regenerate\n";
+    ss << "  command = " << ninja_value(command) << "\n";
+    ss << "  description = Regenerating build.ninja\n";
+    ss << "  generator = 1\n";
+    ss << "  restat = 1\n";
+    ss << "\n";
+    ss << "build build.ninja";
+    for(auto const& file : generated)
+    {
+        ss << " " << file;
+    }
+    ss << ": regenerate";
+    std::set<std::string> seen;
+    for(auto const& path : paths)
+    {
+        std::string file = absolute(path);
+        if(!file.empty() && seen.insert(file).second)
+        {
+            ss << " $\n    " << ninja_escape(file);
+        }
+    }
+    ss << "\n";
+    return ss.str();
+}
+
+/*
+ * Regenerates build.ninja, returns true if its content changed (or would change when check is set).
+ * The toolchain file is read on every run, so there is no stamp; the file and the BinaryData
+ * index are only replaced when their text differs, which keeps ninja from rebuilding what did
+ * not change.
+ */
+bool project::gen_ninja(bool check)
+{
+    std::string ninja_file = get_ninja_file();
+
+    std::string current;
+    bool exists;
+    {
+        profiler::scope s("output read");
+        exists = utilities::readFile(ninja_file, current);
+    }
+
+    std::string content;
+    {
+        profiler::scope s("get_ninja");
+        content = get_ninja();
+    }
+    bool changed = !exists || (content != current);
+
+    if(check)
+    {
+        return changed;
+    }
+
+    profiler::scope s("file write");
+    resourceData data;
+    get_resource_data(data);
+    if(!data.files.empty())
+    {
+        std::string dir = output_path + sepd + "build-ninja" + sepd + "BinaryData";
+        std::vector<std::pair<std::string, std::string>> index = {
+            { "BinaryData.h", data.header },
+            { "BinaryData.cpp", data.index },
+        };
+        if(opts.compressResources)
+        {
+            index.push_back({ "BinaryDataDecoder.h", DECODER_HEADER });
+        }
+        utilities::makeDirectories(dir);
+        for(auto const& file : index)
+        {
+            std::string path = dir + sepd + file.first;
+            std::string text;
+            if((!utilities::readFile(path, text) || text != file.second) && !utilities::writeFileAtomic(path, file.second))
+            {
+                throw std::runtime_error("Error writing file: " + path);
+            }
+        }
+    }
+    if(changed && !utilities::writeFileAtomic(ninja_file, content))
+    {
+        throw std::runtime_error("Error writing file: " + ninja_file);
+    }
+
+    return changed;
 }
 
 void project::print()
+{
+    print(std::cout);
+}
+
+void project::print(std::ostream &os)
 {
     std::stringstream ss;
     ss << "id = " << id << "\n";
@@ -1016,7 +3130,7 @@ void project::print()
     ss << "pluginFormats = " << pluginFormats << "\n";
     ss << "pluginCharacteristicsValue = " << pluginCharacteristicsValue << "\n";
     ss << "userNotes = " << userNotes << "\n";
-    std::cout << ss.str() << std::endl;
+    os << ss.str() << std::endl;
 }
 
 /* These are used when module directories are not present */
@@ -1,14 +1,38 @@
+#pragma once
+
 #include <string>
 #include <ostream>
 #include <vector>
 #include <list>
 #include <map>
+#include <functional>
+#include <memory>
+#include <cstdint>
 #include <pugixml.hpp>
 
+#include "module.h"
+
 class project
 {
 public:
 
+    struct sourceFile
+    {
+        std::string id;
+        std::string name;
+        std::string file;
+        bool compile;
+        bool resource;
+    };
+
+    struct sourceGroup
+    {
+        std::string id;
+        std::string name;
+        std::vector<size_t> files;
+        std::vector<sourceGroup> groups;
+    };
+
     struct buildConfig
     {
         bool valid;
@@ -23,6 +47,7 @@ public:
     struct buildExport
     {
         bool valid;
+        std::string format;
         std::string targetFolder;
         std::vector<std::string> extraDefs;
         std::vector<std::string> externalLibraries;
@@ -36,22 +61,99 @@ public:
         std::string vstLegacyFolder;
         std::string vst3Folder;
         bool microphonePermissionNeeded;
+        std::vector<std::string> modulePaths;
 
+        std::vector<buildConfig> configurations;
         struct buildConfig debug;
         struct buildConfig release;
     };
+
+    /* generator settings that are not part of the .jucer */
+    struct options
+    {
+        bool unity;
+        size_t unityBatchSize;
+        std::vector<std::string> unityExclude;
+        bool precompiledHeader;
+        bool compilerCache;
+        size_t embedShardSize;
+        std::string generator;
+        bool compressResources;
+        std::vector<std::string> compressExclude;
+        bool ninja;
+        std::string toolchain;
+
+        options();
+    };
     
+    /* what the generator has to say, printed by default and collected by library users */
+    struct diagnostic
+    {
+        enum severity { note, warning, error };
+
+        severity level;
+        std::string message;
+        std::string file;
+        long line;
+        long offset;
+    };
+
+    typedef std::function<void(const diagnostic &)> reporter;
+    typedef std::function<void(const char *data, size_t length)> writer;
+
+    static std::string format_diagnostic(const diagnostic &d);
+    /* notes to stdout, warnings and errors to stderr */
+    static void print_diagnostic(const diagnostic &d);
+    /* the generator version, generated projects only use a resource encoder of the same one */
+    static std::string get_version();
+
     project();
-    project(std::string file, std::string outpath);
+    project(std::string file, std::string outpath, const options &opts = options(), reporter report = print_diagnostic);
+    /* parses the .jucer text in data, file is where it lives: paths in the project are relative to it */
+    project(const char *data, size_t length, std::string file, std::string outpath, const options &opts = options(), reporter report = print_diagnostic);
+    void print(std::ostream &os);
     void print();
 
-    void gen_cmake();
+    /* writes the output selected by the options, CMakeLists.txt or build.ninja */
+    bool generate(bool check = false);
+    std::string get_output_file();
+
+    bool gen_cmake(bool check = false);
+    std::string get_cmake();
+    void get_cmake(const writer &write);
     std::string get_cmake_file();
+    std::string get_stamp_file();
+    bool gen_ninja(bool check = false);
+    std::string get_ninja();
+    std::string get_ninja_file();
+    void get_watch_paths(std::vector<std::string> &paths, std::vector<std::string> &folders);
+    std::vector<std::string> get_source_files();
+    std::vector<std::pair<std::string, std::string>> get_resolved_modules();
 
 private:
+    // bench/j2c_bench.cpp times the parse, module lookup and emitters one by one
+    friend class projectBenchmark;
+
     typedef std::map<std::string, std::string> map_t;
 
-    pugi::xml_document m_Doc;
+    /* what the Ninja output builds with, from the toolchain file instead of probing the compiler */
+    struct ninjaToolchain
+    {
+        std::string cc;
+        std::string cxx;
+        std::string cflags;
+        std::string cxxflags;
+        std::string ldflags;
+        std::string debugFlags;
+        std::string releaseFlags;
+        std::string sysroot;
+        std::string pkgConfig;
+    };
+
+    uint64_t jucer_hash;
+    std::string jucer_file;
+    options opts;
+    reporter report;
 
     bool downloadJuceSource;
     std::string base_path;
@@ -101,7 +203,45 @@ private:
     std::string userNotes;
     std::string pluginFormats;
     std::string pluginCharacteristicsValue;
+
+    std::vector<sourceFile> files;
+    sourceGroup mainGroup;
+    std::vector<std::string> modules;
+    std::vector<buildExport> exporters;
+    std::vector<module> juceModules;
+    bool modulesResolved;
+
+    /* parses text in place, original (the file when null) is only read to locate a parse error */
+    void load(std::string file, std::string outpath, char *text, size_t length, const char *original);
+    void parse(pugi::xml_node node);
+    void parse_group(pugi::xml_node node, sourceGroup &group);
+    void parse_export(pugi::xml_node node, buildExport &build);
+    void parse_config(pugi::xml_node node, buildConfig &config);
     
+    /* a resource in a shard, or one part of a resource that is larger than a shard (part counts from 1) */
+    struct resourcePiece
+    {
+        size_t file;
+        size_t part;
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    struct resourceData
+    {
+        std::vector<std::string> files;
+        std::vector<std::string> symbols;
+        std::vector<bool> compressed;
+        // the part lengths of the resources that are split, empty for the others
+        std::vector<std::vector<uint64_t>> parts;
+        std::vector<std::vector<resourcePiece>> shards;
+        std::string header;
+        std::string index;
+    };
+
+    std::vector<std::string> get_resource_symbols(const std::vector<std::string> &resources);
+    void get_resource_data(resourceData &data);
+    std::string get_embed_argument(const resourceData &data, const resourcePiece &piece);
     std::string get_resource_files();
 
     std::string get_header();
@@ -112,13 +252,18 @@ private:
 
     std::string get_resource_list();
     std::string get_source_groups();
+    std::string get_source_groups(const sourceGroup &group, std::string path);
     std::string get_source_list();
+    std::string get_unity_batches();
 
     std::vector<std::string> get_export_formats();
     std::list<std::string> get_module_path_list();
     std::string get_module_paths();
-    std::vector<std::string> get_module_list();
-    std::list<std::string> get_libraries(const project::map_t &system);
+    const std::vector<std::string>& get_module_list();
+    std::list<std::string> get_libraries(const project::map_t &system, std::string (module::*field)());
+    void resolve_modules();
+    bool check_module_dependencies();
+    std::string get_module_libraries();
 
     static const map_t OSXFramework;
     static const map_t iOSFrameworks;
@@ -126,12 +271,17 @@ private:
     static const map_t linuxLibs;
     static const map_t mingwLibs;
 
+    void get_library_code(std::vector<std::string> &cpp, std::vector<std::string> &mm);
     std::string get_autogen_vars();
 
     std::string get_include_dirs();
+    std::vector<std::string> get_definitions();
     std::string get_defines();
     std::string get_cpp_standard();
+    std::string get_compiler_cache();
+    std::string get_search_path(const std::string &path);
     std::string get_executable();
+    std::string get_precompiled_header();
     std::string get_common_options();
     std::string get_target_config();
     std::string get_apple_osx_config();
@@ -140,4 +290,13 @@ private:
     std::string get_msvc_config();
 
     void get_export(std::string target, project::buildExport &build);
+
+    void get_toolchain(ninjaToolchain &t);
+    std::string get_ninja_regenerate(const std::vector<std::string> &generated);
+    std::string get_pkg_config(const ninjaToolchain &t, const std::list<std::string> &packages, const char *query);
+
+    std::vector<std::string> get_module_headers();
+    std::vector<std::string> get_sized_files();
+    std::string get_options_key();
+    std::string get_input_hash();
 };
@@ -0,0 +1,335 @@
+#include "server.h"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "utilities.h"
+
+namespace
+{
+    const uint32_t MAX_FRAME = 16 * 1024 * 1024;
+
+    // a client that stops reading or writing in the middle of a frame is dropped after this
+    const int IO_TIMEOUT_SECONDS = 5;
+
+    bool setTimeouts(int fd)
+    {
+        struct timeval timeout;
+        timeout.tv_sec = IO_TIMEOUT_SECONDS;
+        timeout.tv_usec = 0;
+        return setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0
+            && setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == 0;
+    }
+
+    bool fillAddress(const std::string& path, struct sockaddr_un& address)
+    {
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+        {
+            return false;
+        }
+        memcpy(address.sun_path, path.c_str(), path.size());
+        return true;
+    }
+
+    bool writeAll(int fd, const char* data, size_t length)
+    {
+        while (length > 0)
+        {
+            ssize_t n = write(fd, data, length);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            data += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    bool readAll(int fd, char* data, size_t length)
+    {
+        while (length > 0)
+        {
+            ssize_t n = read(fd, data, length);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            data += n;
+            length -= n;
+        }
+        return true;
+    }
+}
+
+bool server::sendFrame(int fd, const std::string& payload)
+{
+    uint32_t length = payload.size();
+    unsigned char header[4] = {
+        static_cast<unsigned char>(length >> 24), static_cast<unsigned char>(length >> 16),
+        static_cast<unsigned char>(length >> 8), static_cast<unsigned char>(length) };
+    return writeAll(fd, reinterpret_cast<const char*>(header), 4) && writeAll(fd, payload.data(), payload.size());
+}
+
+bool server::receiveFrame(int fd, std::string& payload)
+{
+    unsigned char header[4];
+    if (!readAll(fd, reinterpret_cast<char*>(header), 4))
+    {
+        return false;
+    }
+    uint32_t length = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16) | (uint32_t(header[2]) << 8) | header[3];
+    if (length > MAX_FRAME)
+    {
+        return false;
+    }
+    payload.resize(length);
+    return readAll(fd, &payload[0], length);
+}
+
+server::server(std::string socketPath)
+{
+    path = socketPath;
+
+    struct sockaddr_un address;
+    if (!fillAddress(path, address))
+    {
+        throw std::runtime_error("Socket path too long: " + path);
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Error creating socket: " + path);
+    }
+
+    // a socket file left behind by a server that is gone is replaced, a live one is not
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0)
+    {
+        close(fd);
+        throw std::runtime_error("Server already running: " + path);
+    }
+    unlink(path.c_str());
+
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 16) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Error listening on socket: " + path);
+    }
+}
+
+server::~server()
+{
+    close(fd);
+    unlink(path.c_str());
+}
+
+void server::setOptions(const project::options &o)
+{
+    opts = o;
+}
+
+/*
+ * A parsed project is reused while the .jucer, the module headers and the other files it read
+ * keep their mtimes, otherwise it is parsed again.  The module index stays warm in between.
+ */
+project& server::load(const std::string& input, const std::string& output)
+{
+    std::string key = input + "\n" + output;
+    auto it = projects.find(key);
+    if (it != projects.end())
+    {
+        bool current = true;
+        for (auto const& file : it->second.inputs)
+        {
+            if (utilities::getModifiedTime(file.first) != file.second)
+            {
+                current = false;
+                break;
+            }
+        }
+        if (current)
+        {
+            return *it->second.proj;
+        }
+        projects.erase(it);
+    }
+
+    entry e;
+    e.proj.reset(new project(input, output, opts));
+
+    std::vector<std::string> paths;
+    std::vector<std::string> folders;
+    e.proj->get_watch_paths(paths, folders);
+    paths.insert(paths.end(), folders.begin(), folders.end());
+    for (auto const& file : paths)
+    {
+        e.inputs.push_back({ file, utilities::getModifiedTime(file) });
+    }
+
+    return *projects.emplace(key, std::move(e)).first->second.proj;
+}
+
+std::string server::handle(const std::vector<std::string>& request, bool& stop)
+{
+    std::stringstream ss;
+    const std::string& command = request[0];
+
+    if (command == "stop")
+    {
+        stop = true;
+    }
+    else if (command == "regenerate" && (request.size() == 2 || request.size() == 3))
+    {
+        project& proj = load(request[1], request.size() == 3 ? request[2] : "");
+        bool changed = proj.generate();
+        ss << (changed ? "Created " : "Unchanged ") << proj.get_output_file() << "\n";
+    }
+    else if (command == "sources" && request.size() == 2)
+    {
+        for (auto const& file : load(request[1], "").get_source_files())
+        {
+            ss << file << "\n";
+        }
+    }
+    else if (command == "modules" && request.size() == 2)
+    {
+        for (auto const& m : load(request[1], "").get_resolved_modules())
+        {
+            ss << m.first << "\t" << m.second << "\n";
+        }
+    }
+    else
+    {
+        throw std::runtime_error("Invalid request: " + command);
+    }
+
+    return ss.str();
+}
+
+/*
+ * One connection at a time, requests are served from memory and take a few milliseconds.  The
+ * socket timeouts keep a stalled client from blocking the others: a read or write that makes
+ * no progress for IO_TIMEOUT_SECONDS closes its connection.
+ */
+int server::run()
+{
+    signal(SIGPIPE, SIG_IGN);
+    std::cout << "Listening on " << path << std::endl;
+
+    bool stop = false;
+    while (!stop)
+    {
+        int connection = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (connection < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            std::cerr << "Error accepting connection on " << path << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!setTimeouts(connection))
+        {
+            close(connection);
+            continue;
+        }
+
+        std::string payload;
+        while (!stop && receiveFrame(connection, payload))
+        {
+            std::vector<std::string> request;
+            for (auto line : utilities::split(payload, '\n'))
+            {
+                request.push_back(std::string(line));
+            }
+
+            std::string reply;
+            if (request.empty())
+            {
+                reply = "error\nEmpty request\n";
+            }
+            else
+            {
+                try
+                {
+                    reply = "ok\n" + handle(request, stop);
+                }
+                catch (const std::exception& e)
+                {
+                    reply = std::string("error\n") + e.what() + "\n";
+                }
+            }
+
+            if (!sendFrame(connection, reply))
+            {
+                break;
+            }
+        }
+        close(connection);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+client::client(std::string socketPath)
+{
+    path = socketPath;
+}
+
+/* sends one request, the reply is the text after the status line; false on "error" or when the server is not reachable */
+bool client::request(const std::vector<std::string>& arguments, std::string& reply)
+{
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || !fillAddress(path, address) || connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        reply = "Cannot connect to " + path + "\n";
+        return false;
+    }
+
+    std::string payload;
+    for (auto const& arg : arguments)
+    {
+        payload += arg + "\n";
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    std::string response;
+    bool ok = server::sendFrame(fd, payload) && server::receiveFrame(fd, response);
+    close(fd);
+    if (!ok)
+    {
+        reply = "No reply from " + path + "\n";
+        return false;
+    }
+
+    size_t eol = response.find('\n');
+    std::string status = response.substr(0, eol);
+    reply = (eol == std::string::npos) ? "" : response.substr(eol + 1);
+    return status == "ok";
+}
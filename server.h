@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+
+#include "project.h"
+
+/*
+ * Long running jucer2cmake (--serve <socket>) that keeps parsed projects in memory, together
+ * with the module index of the process.  Requests and replies are frames on a Unix socket:
+ * a 4 byte big endian length and that many bytes of text.  A request is a command and its
+ * arguments, one per line:
+ *
+ *   regenerate <jucer> [output]    Created|Unchanged <CMakeLists.txt>
+ *   sources <jucer>                project relative file paths, one per line
+ *   modules <jucer>                <id> <tab> <header>, the header is empty when not found
+ *   stop                           the server exits after replying
+ *
+ * The first line of a reply is "ok" or "error", the rest is the result or the error message.
+ */
+class server
+{
+public:
+    server(std::string socketPath);
+    ~server();
+
+    void setOptions(const project::options &o);
+    int run();
+
+    static bool sendFrame(int fd, const std::string& payload);
+    static bool receiveFrame(int fd, std::string& payload);
+
+private:
+    struct entry
+    {
+        std::unique_ptr<project> proj;
+        // the files the parsed state was derived from and their mtimes
+        std::vector<std::pair<std::string, int64_t>> inputs;
+    };
+
+    project& load(const std::string& input, const std::string& output);
+    std::string handle(const std::vector<std::string>& request, bool& stop);
+
+    std::string path;
+    int fd;
+    project::options opts;
+    std::map<std::string, entry> projects;
+};
+
+/* the client side, jucer2cmake --connect <socket> <command> [arguments] */
+class client
+{
+public:
+    client(std::string socketPath);
+
+    bool request(const std::vector<std::string>& arguments, std::string& reply);
+
+private:
+    std::string path;
+};
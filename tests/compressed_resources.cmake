@@ -0,0 +1,75 @@
+# Builds a project whose code reads a compressed resource through JuceLibraryCode/JuceHeader.h
+# and checks the bytes it gets.  The conversion has to be refused while the Projucer's
+# JuceLibraryCode/BinaryData.h exists, since JuceHeader.h would include it instead.
+#
+#   cmake -DJUCER2CMAKE=<jucer2cmake> -DWORK_DIR=<folder> -P compressed_resources.cmake
+
+if(NOT JUCER2CMAKE OR NOT WORK_DIR)
+    message(FATAL_ERROR "JUCER2CMAKE and WORK_DIR are required")
+endif()
+
+set(PROJECT_DIR ${WORK_DIR}/project)
+file(REMOVE_RECURSE ${WORK_DIR})
+
+string(REPEAT "hello resource " 64 CONTENT)
+file(WRITE ${PROJECT_DIR}/Resources/hello.txt "${CONTENT}")
+file(WRITE ${PROJECT_DIR}/JuceLibraryCode/JuceHeader.h "#pragma once\n#include \"BinaryData.h\"\n")
+file(WRITE ${PROJECT_DIR}/JuceLibraryCode/BinaryData.h "#pragma once\nnamespace BinaryData\n{\n    extern const char* hello_txt;\n    const int hello_txtSize = 960;\n}\n")
+file(WRITE ${PROJECT_DIR}/Source/Main.cpp [=[
+#include <cstdio>
+#include <string>
+#include "../JuceLibraryCode/JuceHeader.h"
+
+int main()
+{
+    std::fwrite (BinaryData::hello_txt, 1, BinaryData::hello_txtSize, stdout);
+    return std::string (BinaryData::hello_txt) == std::string (BinaryData::hello_txt, BinaryData::hello_txtSize) ? 0 : 1;
+}
+]=])
+file(WRITE ${PROJECT_DIR}/Compressed.jucer [=[<?xml version="1.0" encoding="UTF-8"?>
+<JUCERPROJECT id="cmpres" name="Compressed" projectType="consoleapp" version="1.0.0" cppLanguageStandard="17">
+  <MAINGROUP id="main" name="Compressed">
+    <GROUP id="src" name="Source">
+      <FILE id="f1" name="Main.cpp" compile="1" resource="0" file="Source/Main.cpp"/>
+    </GROUP>
+    <GROUP id="res" name="Resources">
+      <FILE id="f2" name="hello.txt" compile="0" resource="1" file="Resources/hello.txt"/>
+    </GROUP>
+  </MAINGROUP>
+</JUCERPROJECT>
+]=])
+
+execute_process(COMMAND ${JUCER2CMAKE} --compress-resources ${PROJECT_DIR}/Compressed.jucer
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+if(result EQUAL 0)
+    message(FATAL_ERROR "compressing with JuceLibraryCode/BinaryData.h present was not refused:\n${output}")
+endif()
+
+file(REMOVE ${PROJECT_DIR}/JuceLibraryCode/BinaryData.h)
+execute_process(COMMAND ${JUCER2CMAKE} --compress-resources ${PROJECT_DIR}/Compressed.jucer
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "conversion failed:\n${output}")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -S ${PROJECT_DIR} -B ${WORK_DIR}/build -DCMAKE_BUILD_TYPE=Release -DJUCER2CMAKE_PROGRAM=${JUCER2CMAKE}
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "configuring the generated project failed:\n${output}")
+endif()
+execute_process(COMMAND ${CMAKE_COMMAND} --build ${WORK_DIR}/build
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "building the generated project failed:\n${output}")
+endif()
+
+# the CMake script fallback does not compress, the decoder is only exercised by jucer2cmake --embed
+file(READ ${WORK_DIR}/build/BinaryData/BinaryData_1.cpp shard)
+if(NOT shard MATCHES "hello_txt_data, ([0-9]+), 960\\)" OR NOT CMAKE_MATCH_1 LESS 960)
+    message(FATAL_ERROR "hello.txt was not embedded compressed")
+endif()
+
+execute_process(COMMAND ${WORK_DIR}/build/Compressed RESULT_VARIABLE result OUTPUT_VARIABLE decoded)
+if(NOT result EQUAL 0 OR NOT decoded STREQUAL CONTENT)
+    message(FATAL_ERROR "the resource read through JuceHeader.h is wrong (${result}):\n${decoded}")
+endif()
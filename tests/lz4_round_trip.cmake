@@ -0,0 +1,92 @@
+# Builds a project with LZ4 compressed resources that exercise the edges of the block format
+# (empty, shorter than a match, runs longer than the 64 KB window, literals that do not
+# compress) and checks that every one decompresses to its original bytes.
+#
+#   cmake -DJUCER2CMAKE=<jucer2cmake> -DWORK_DIR=<folder> -P lz4_round_trip.cmake
+
+if(NOT JUCER2CMAKE OR NOT WORK_DIR)
+    message(FATAL_ERROR "JUCER2CMAKE and WORK_DIR are required")
+endif()
+
+set(PROJECT_DIR ${WORK_DIR}/project)
+file(REMOVE_RECURSE ${WORK_DIR})
+
+set(EMPTY "")
+set(TINY "abc")
+string(REPEAT "a" 70000 RUN)
+string(RANDOM LENGTH 4000 RANDOM_SEED 15 NOISE)
+string(REPEAT "${NOISE}" 3 REPEATED)
+set(MIXED "${NOISE}${RUN}${TINY}${REPEATED}")
+foreach(name EMPTY TINY RUN NOISE MIXED)
+    string(TOLOWER ${name} file)
+    file(WRITE ${PROJECT_DIR}/Resources/${file}.txt "${${name}}")
+endforeach()
+
+file(WRITE ${PROJECT_DIR}/Source/Main.cpp [=[
+#include <cstdio>
+#include "BinaryData.h"
+
+static void print (const char* data, int size)
+{
+    std::fwrite (data, 1, size, stdout);
+    std::fputs ("|", stdout);
+}
+
+int main()
+{
+    print (BinaryData::empty_txt, BinaryData::empty_txtSize);
+    print (BinaryData::tiny_txt, BinaryData::tiny_txtSize);
+    print (BinaryData::run_txt, BinaryData::run_txtSize);
+    print (BinaryData::noise_txt, BinaryData::noise_txtSize);
+    print (BinaryData::mixed_txt, BinaryData::mixed_txtSize);
+    return 0;
+}
+]=])
+file(WRITE ${PROJECT_DIR}/RoundTrip.jucer [=[<?xml version="1.0" encoding="UTF-8"?>
+<JUCERPROJECT id="lz4rt" name="RoundTrip" projectType="consoleapp" version="1.0.0" cppLanguageStandard="17">
+  <MAINGROUP id="main" name="RoundTrip">
+    <GROUP id="src" name="Source">
+      <FILE id="f1" name="Main.cpp" compile="1" resource="0" file="Source/Main.cpp"/>
+    </GROUP>
+    <GROUP id="res" name="Resources">
+      <FILE id="f2" name="empty.txt" compile="0" resource="1" file="Resources/empty.txt"/>
+      <FILE id="f3" name="tiny.txt" compile="0" resource="1" file="Resources/tiny.txt"/>
+      <FILE id="f4" name="run.txt" compile="0" resource="1" file="Resources/run.txt"/>
+      <FILE id="f5" name="noise.txt" compile="0" resource="1" file="Resources/noise.txt"/>
+      <FILE id="f6" name="mixed.txt" compile="0" resource="1" file="Resources/mixed.txt"/>
+    </GROUP>
+  </MAINGROUP>
+</JUCERPROJECT>
+]=])
+
+execute_process(COMMAND ${JUCER2CMAKE} --compress-resources ${PROJECT_DIR}/RoundTrip.jucer
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "conversion failed:\n${output}")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -S ${PROJECT_DIR} -B ${WORK_DIR}/build -DCMAKE_BUILD_TYPE=Release -DJUCER2CMAKE_PROGRAM=${JUCER2CMAKE}
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "configuring the generated project failed:\n${output}")
+endif()
+execute_process(COMMAND ${CMAKE_COMMAND} --build ${WORK_DIR}/build
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "building the generated project failed:\n${output}")
+endif()
+
+# the runs have to be stored compressed, or the decoder was not exercised
+file(GLOB shards ${WORK_DIR}/build/BinaryData/BinaryData_*.cpp)
+foreach(shard_file ${shards})
+    file(READ ${shard_file} shard)
+    string(APPEND sources "${shard}")
+endforeach()
+if(NOT sources MATCHES "run_txt_data, ([0-9]+), 70000\\)" OR NOT CMAKE_MATCH_1 LESS 1000)
+    message(FATAL_ERROR "run.txt was not embedded compressed")
+endif()
+
+execute_process(COMMAND ${WORK_DIR}/build/RoundTrip RESULT_VARIABLE result OUTPUT_VARIABLE decoded)
+if(NOT result EQUAL 0 OR NOT decoded STREQUAL "${EMPTY}|${TINY}|${RUN}|${NOISE}|${MIXED}|")
+    message(FATAL_ERROR "the resources did not decompress to their contents (${result})")
+endif()
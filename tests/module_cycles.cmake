@@ -0,0 +1,80 @@
+# Converts a project whose modules declare a dependency cycle, which has to be reported with
+# the modules on it and keep the modules out of their own libraries, and then the same project
+# without the cycle, whose modules get their libraries in declaration order.
+#
+#   cmake -DJUCER2CMAKE=<jucer2cmake> -DWORK_DIR=<folder> -P module_cycles.cmake
+
+if(NOT JUCER2CMAKE OR NOT WORK_DIR)
+    message(FATAL_ERROR "JUCER2CMAKE and WORK_DIR are required")
+endif()
+
+set(PROJECT_DIR ${WORK_DIR}/project)
+file(REMOVE_RECURSE ${WORK_DIR})
+
+function(write_module id dependencies)
+    file(WRITE ${PROJECT_DIR}/modules/${id}/${id}.h
+        "/*\n BEGIN_JUCE_MODULE_DECLARATION\n\n"
+        "  ID:               ${id}\n"
+        "  vendor:           test\n"
+        "  version:          1.0.0\n"
+        "  name:             ${id}\n"
+        "  dependencies:     ${dependencies}\n"
+        "\n END_JUCE_MODULE_DECLARATION\n*/\n")
+endfunction()
+
+# mod_a only depends on the cycle between mod_b and mod_c, mod_d on a module the project lacks
+write_module(mod_a "mod_b")
+write_module(mod_b "mod_c")
+write_module(mod_c "mod_b")
+write_module(mod_d "mod_x")
+
+file(WRITE ${PROJECT_DIR}/Cycles.jucer [=[<?xml version="1.0" encoding="UTF-8"?>
+<JUCERPROJECT id="cycles" name="Cycles" projectType="consoleapp" version="1.0.0">
+  <MAINGROUP id="main" name="Cycles"/>
+  <EXPORTFORMATS>
+    <LINUX_MAKE targetFolder="Builds/LinuxMakefile">
+      <MODULEPATHS>
+        <MODULEPATH id="mod_a" path="modules"/>
+        <MODULEPATH id="mod_b" path="modules"/>
+        <MODULEPATH id="mod_c" path="modules"/>
+        <MODULEPATH id="mod_d" path="modules"/>
+      </MODULEPATHS>
+    </LINUX_MAKE>
+  </EXPORTFORMATS>
+  <MODULES>
+    <MODULE id="mod_a"/>
+    <MODULE id="mod_b"/>
+    <MODULE id="mod_c"/>
+    <MODULE id="mod_d"/>
+  </MODULES>
+</JUCERPROJECT>
+]=])
+
+execute_process(COMMAND ${JUCER2CMAKE} --module-index ${WORK_DIR}/modules.index ${PROJECT_DIR}/Cycles.jucer
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE errors)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "conversion failed:\n${output}${errors}")
+endif()
+if(NOT errors MATCHES "Cyclic module dependencies between: mod_b mod_c\n")
+    message(FATAL_ERROR "the cycle between mod_b and mod_c was not reported:\n${errors}")
+endif()
+if(NOT errors MATCHES "Module mod_d depends on mod_x, which is not in the project")
+    message(FATAL_ERROR "the missing dependency of mod_d was not reported:\n${errors}")
+endif()
+file(READ ${PROJECT_DIR}/CMakeLists.txt generated)
+if(generated MATCHES "jucer_module_library")
+    message(FATAL_ERROR "module libraries were created despite the cycle")
+endif()
+
+write_module(mod_c "")
+execute_process(COMMAND ${JUCER2CMAKE} --module-index ${WORK_DIR}/modules.index ${PROJECT_DIR}/Cycles.jucer
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE errors)
+if(NOT result EQUAL 0 OR errors MATCHES "Cyclic")
+    message(FATAL_ERROR "conversion without the cycle failed:\n${output}${errors}")
+endif()
+file(READ ${PROJECT_DIR}/CMakeLists.txt generated)
+string(REGEX MATCHALL "jucer_module_library\\(Cycles_mod_[a-d]" libraries "${generated}")
+string(REPLACE "jucer_module_library(Cycles_" "" libraries "${libraries}")
+if(NOT libraries STREQUAL "mod_a;mod_b;mod_c;mod_d")
+    message(FATAL_ERROR "expected the module libraries in declaration order, got: ${libraries}")
+endif()
@@ -0,0 +1,70 @@
+# Generates build.ninja for a project in a folder whose name needs ninja escaping and shell
+# quoting (a space, a dollar and a quote), with such source and resource names and a quoted
+# define, builds it with ninja and checks what the program prints.  Skipped without ninja.
+#
+#   cmake -DJUCER2CMAKE=<jucer2cmake> -DWORK_DIR=<folder> [-DNINJA=<ninja>] -P ninja_quoting.cmake
+
+if(NOT JUCER2CMAKE OR NOT WORK_DIR)
+    message(FATAL_ERROR "JUCER2CMAKE and WORK_DIR are required")
+endif()
+
+if(NOT NINJA)
+    find_program(NINJA ninja)
+endif()
+if(NOT NINJA)
+    message("Skipped: ninja not found")
+    return()
+endif()
+
+set(PROJECT_DIR "${WORK_DIR}/it's a $dir")
+file(REMOVE_RECURSE ${WORK_DIR})
+
+file(WRITE "${PROJECT_DIR}/Resources/a note.txt" "quoted resource")
+file(WRITE "${PROJECT_DIR}/Source/main $file.cpp" [=[
+#include <cstdio>
+#include "BinaryData.h"
+
+int main()
+{
+    std::printf ("%s %.*s", GREETING, BinaryData::a_note_txtSize, BinaryData::a_note_txt);
+    return 0;
+}
+]=])
+file(WRITE "${PROJECT_DIR}/Quoting.jucer" [=[<?xml version="1.0" encoding="UTF-8"?>
+<JUCERPROJECT id="quote" name="Quoting" projectType="consoleapp" version="1.0.0" cppLanguageStandard="17"
+              defines="GREETING=&quot;it's$HOME&amp;more&quot;">
+  <MAINGROUP id="main" name="Quoting">
+    <GROUP id="src" name="Source">
+      <FILE id="f1" name="main $file.cpp" compile="1" resource="0" file="Source/main $file.cpp"/>
+    </GROUP>
+    <GROUP id="res" name="Resources">
+      <FILE id="f2" name="a note.txt" compile="0" resource="1" file="Resources/a note.txt"/>
+    </GROUP>
+  </MAINGROUP>
+  <EXPORTFORMATS>
+    <LINUX_MAKE targetFolder="Builds/LinuxMakefile">
+      <CONFIGURATIONS>
+        <CONFIGURATION name="Debug" isDebug="1"/>
+        <CONFIGURATION name="Release" isDebug="0"/>
+      </CONFIGURATIONS>
+    </LINUX_MAKE>
+  </EXPORTFORMATS>
+</JUCERPROJECT>
+]=])
+
+execute_process(COMMAND ${JUCER2CMAKE} --ninja "${PROJECT_DIR}/Quoting.jucer"
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "conversion failed:\n${output}")
+endif()
+
+execute_process(COMMAND ${NINJA} WORKING_DIRECTORY "${PROJECT_DIR}"
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "building the generated build.ninja failed:\n${output}")
+endif()
+
+execute_process(COMMAND "${PROJECT_DIR}/build-ninja/Release/Quoting" RESULT_VARIABLE result OUTPUT_VARIABLE printed)
+if(NOT result EQUAL 0 OR NOT printed STREQUAL "it's$HOME&more quoted resource")
+    message(FATAL_ERROR "the program printed the wrong text (${result}): ${printed}")
+endif()
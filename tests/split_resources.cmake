@@ -0,0 +1,85 @@
+# Builds a project whose resources are larger than a shard, so that they are embedded in parts
+# joined by the BinaryData index, and checks the bytes the program reads back.  Once compressed
+# through jucer2cmake --embed and once plain through the CMake script fallback.
+#
+#   cmake -DJUCER2CMAKE=<jucer2cmake> -DWORK_DIR=<folder> -P split_resources.cmake
+
+if(NOT JUCER2CMAKE OR NOT WORK_DIR)
+    message(FATAL_ERROR "JUCER2CMAKE and WORK_DIR are required")
+endif()
+
+set(PROJECT_DIR ${WORK_DIR}/project)
+file(REMOVE_RECURSE ${WORK_DIR})
+
+# 5000 and 3100 bytes, several parts each with a 1 KB shard
+string(REPEAT "split text resource " 250 TEXT)
+string(REPEAT "0123456789" 310 IMAGE)
+file(WRITE ${PROJECT_DIR}/Resources/large.txt "${TEXT}")
+file(WRITE ${PROJECT_DIR}/Resources/large.png "${IMAGE}")
+file(WRITE ${PROJECT_DIR}/Source/Main.cpp [=[
+#include <cstdio>
+#include "BinaryData.h"
+
+int main()
+{
+    int size = 0;
+    const char* text = BinaryData::getNamedResource ("large_txt", size);
+    if (text == nullptr || size != BinaryData::large_txtSize || BinaryData::large_pngSize != 3100)
+        return 1;
+    std::fwrite (text, 1, size, stdout);
+    std::fwrite (BinaryData::large_png, 1, BinaryData::large_pngSize, stdout);
+    return 0;
+}
+]=])
+file(WRITE ${PROJECT_DIR}/Split.jucer [=[<?xml version="1.0" encoding="UTF-8"?>
+<JUCERPROJECT id="splres" name="Split" projectType="consoleapp" version="1.0.0" cppLanguageStandard="17">
+  <MAINGROUP id="main" name="Split">
+    <GROUP id="src" name="Source">
+      <FILE id="f1" name="Main.cpp" compile="1" resource="0" file="Source/Main.cpp"/>
+    </GROUP>
+    <GROUP id="res" name="Resources">
+      <FILE id="f2" name="large.txt" compile="0" resource="1" file="Resources/large.txt"/>
+      <FILE id="f3" name="large.png" compile="0" resource="1" file="Resources/large.png"/>
+    </GROUP>
+  </MAINGROUP>
+</JUCERPROJECT>
+]=])
+
+foreach(variant compressed plain)
+    if(variant STREQUAL "compressed")
+        set(options --compress-resources)
+        set(program ${JUCER2CMAKE})
+    else()
+        set(options)
+        set(program ${WORK_DIR}/no-jucer2cmake)
+    endif()
+    set(BUILD_DIR ${WORK_DIR}/build-${variant})
+
+    execute_process(COMMAND ${JUCER2CMAKE} ${options} --embed-shard-size 1 ${PROJECT_DIR}/Split.jucer
+        RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${variant} conversion failed:\n${output}")
+    endif()
+
+    execute_process(COMMAND ${CMAKE_COMMAND} -S ${PROJECT_DIR} -B ${BUILD_DIR} -DCMAKE_BUILD_TYPE=Release -DJUCER2CMAKE_PROGRAM=${program}
+        RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "configuring the ${variant} project failed:\n${output}")
+    endif()
+    execute_process(COMMAND ${CMAKE_COMMAND} --build ${BUILD_DIR}
+        RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "building the ${variant} project failed:\n${output}")
+    endif()
+
+    file(GLOB shards ${BUILD_DIR}/BinaryData/BinaryData_*.cpp)
+    list(LENGTH shards count)
+    if(count LESS 8)
+        message(FATAL_ERROR "the ${variant} resources were not split, ${count} shards")
+    endif()
+
+    execute_process(COMMAND ${BUILD_DIR}/Split RESULT_VARIABLE result OUTPUT_VARIABLE joined)
+    if(NOT result EQUAL 0 OR NOT joined STREQUAL "${TEXT}${IMAGE}")
+        message(FATAL_ERROR "the ${variant} resources read back wrong (${result}):\n${joined}")
+    endif()
+endforeach()
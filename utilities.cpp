@@ -1,133 +1,221 @@
 #include "utilities.h"
+#include "profiler.h"
 
 #include <string>
 #include <sstream>
 #include <iostream>
 #include <algorithm>
-#include <stack>
 #include <map>
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <errno.h>
 
 namespace utilities
 {
-    const std::string WHITESPACE = " \n\r\t\f\v";
+    constexpr std::string_view WHITESPACE = " \n\r\t\f\v";
+    constexpr std::string_view LIST_SEPARATORS = " ,\n\r\t\f\v";
 
-    std::string ltrim(const std::string& s)
+    std::string_view ltrim(std::string_view s)
     {
         size_t start = s.find_first_not_of(WHITESPACE);
-        return (start == std::string::npos) ? "" : s.substr(start);
+        return (start == std::string_view::npos) ? std::string_view() : s.substr(start);
     }
 
-    std::string rtrim(const std::string& s)
+    std::string_view rtrim(std::string_view s)
     {
         size_t end = s.find_last_not_of(WHITESPACE);
-        return (end == std::string::npos) ? "" : s.substr(0, end + 1);
+        return (end == std::string_view::npos) ? std::string_view() : s.substr(0, end + 1);
     }
 
-    std::string trim(const std::string& s)
+    std::string_view trim(std::string_view s)
     {
         return rtrim(ltrim(s));
     }
 
-    std::vector<std::string> split(const std::string& s, char delimiter)
+    /* like std::getline, a trailing delimiter does not produce an empty last token */
+    std::vector<std::string_view> split(std::string_view s, char delimiter)
     {
-        std::vector<std::string> tokens;
-        std::string token;
-        std::istringstream tokenStream(s);
-        while (std::getline(tokenStream, token, delimiter))
+        std::vector<std::string_view> tokens;
+        size_t pos = 0;
+        while (pos < s.length())
         {
-            tokens.push_back(token);
+            size_t end = s.find(delimiter, pos);
+            if (end == std::string_view::npos)
+            {
+                end = s.length();
+            }
+            tokens.push_back(s.substr(pos, end - pos));
+            pos = end + 1;
         }
         return tokens;
     }
 
-    bool replace(std::string& str, const std::string& from, const std::string& to)
-    {
-        size_t start_pos = str.find(from);
-        if(start_pos == std::string::npos)
-        {
-            return false;
-        }
-        str.replace(start_pos, from.length(), to);
-        return true;
-    }
-
-    std::vector<std::string> getValueList(std::string value)
+    /* values of a module declaration are separated by commas and/or whitespace */
+    std::vector<std::string_view> getValueList(std::string_view value)
     {
-        if(value.empty())
+        std::vector<std::string_view> list;
+        size_t pos = value.find_first_not_of(LIST_SEPARATORS);
+        while (pos != std::string_view::npos)
         {
-            return std::vector<std::string>();
+            size_t end = value.find_first_of(LIST_SEPARATORS, pos);
+            list.push_back(value.substr(pos, (end == std::string_view::npos) ? std::string_view::npos : end - pos));
+            pos = value.find_first_not_of(LIST_SEPARATORS, end);
         }
-
-        value = utilities::trim(value);
-        std::replace( value.begin(), value.end(), ',', ' ');
-        while(replace(value, "  ", " "));
-        auto list = utilities::split(value,' ');
 #if defined(DEBUG)
         std::cout << "KeyValue List: [" << value << "]" << std::endl;
-        for(auto &item : list)
+        for(auto const& item : list)
         {
-        std::cout << "Value: [" << item << "]" << std::endl;
-            item = utilities::trim(item);
+            std::cout << "Value: [" << item << "]" << std::endl;
         }
-#endif            
+#endif
         return list;
     }
 
-
-    std::string normalizePath(std::string &path)
+    /*
+     * Collapses separators and resolves "." and ".." in place.  The result always starts
+     * with the separator, so the components are never written ahead of the read position.
+     */
+    void normalizePath(std::string &path)
     {
-        std::string sep = (path.find("\\") != std::string::npos) ? "\\" : "/";
-
-        std::stack<std::string> st;
-        std::string dir;
-        std::string res = sep;
-
-        size_t len_path = path.length();
+        const char sep = (path.find('\\') != std::string::npos) ? '\\' : '/';
+        if (path.empty() || path[0] != sep)
+        {
+            path.insert(path.begin(), sep);
+        }
 
-        for (size_t i = 0; i < len_path; i++)
+        size_t length = path.length();
+        size_t out = 0;
+        size_t pos = 0;
+        while (pos < length)
         {
-            dir.clear();
-            while (path[i] == sep[0])
-                i++;
-            while (i < len_path && path[i] != sep[0]) {
-                dir.push_back(path[i]);
-                i++;
+            while (pos < length && path[pos] == sep)
+            {
+                pos++;
+            }
+            size_t start = pos;
+            while (pos < length && path[pos] != sep)
+            {
+                pos++;
             }
+            size_t len = pos - start;
 
-            if (dir.compare("..") == 0)
+            if (len == 0 || (len == 1 && path[start] == '.'))
             {
-                if (!st.empty())
-                    st.pop();
+                continue;
             }
-            else if (dir.compare(".") == 0)
+            if (len == 2 && path[start] == '.' && path[start + 1] == '.')
+            {
+                if (out > 0)
+                {
+                    out = path.rfind(sep, out - 1);
+                }
                 continue;
-            else if (dir.length() != 0)
-                st.push(dir);
+            }
+
+            path[out] = sep;
+            std::copy(path.begin() + start, path.begin() + pos, path.begin() + out + 1);
+            out += len + 1;
         }
 
-        std::stack<std::string> st1;
-        while (!st.empty())
+        path.resize(out == 0 ? 1 : out);
+    }
+
+    /* 64-bit FNV-1a, pass the previous result as seed to hash several buffers */
+    uint64_t hash(const char* data, size_t length, uint64_t seed)
+    {
+        uint64_t h = seed;
+        for (size_t i = 0; i < length; i++)
         {
-            st1.push(st.top());
-            st.pop();
+            h ^= static_cast<unsigned char>(data[i]);
+            h *= 1099511628211ULL;
         }
+        return h;
+    }
 
-        while (!st1.empty())
+    std::string toHex(uint64_t value)
+    {
+        std::stringstream ss;
+        ss << std::hex;
+        ss.width(16);
+        ss.fill('0');
+        ss << value;
+        return ss.str();
+    }
+
+    bool readFile(const std::string& path, std::string& contents)
+    {
+        profiler::count(profiler::fsOpen);
+        std::ifstream is(path, std::ifstream::binary);
+        if (!is)
         {
-            std::string temp = st1.top();
-            
-            if (st1.size() != 1)
+            return false;
+        }
+        std::stringstream ss;
+        ss << is.rdbuf();
+        contents = ss.str();
+        return true;
+    }
+
+    /* writes next to the target and renames over it, readers never see a partial file */
+    bool writeFileAtomic(const std::string& path, const std::string& contents)
+    {
+        std::string tmp = path + ".tmp" + std::to_string(getpid());
+        profiler::count(profiler::fsOpen);
+        {
+            std::ofstream os(tmp, std::ofstream::binary | std::ofstream::trunc);
+            if (!os)
             {
-                res.append(temp + sep);
+                return false;
             }
-            else
+            os.write(contents.data(), contents.size());
+            os.close();
+            if (!os)
             {
-                res.append(temp);
+                std::remove(tmp.c_str());
+                return false;
             }
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
 
-            st1.pop();
+    /* nanosecond modification time, -1 if the path does not exist */
+    int64_t getModifiedTime(const std::string& path, bool* isDirectory)
+    {
+        struct stat info;
+        profiler::count(profiler::fsStat);
+        if (stat(path.c_str(), &info) != 0)
+        {
+            return -1;
+        }
+        if (isDirectory)
+        {
+            *isDirectory = S_ISDIR(info.st_mode);
         }
+#if defined(__APPLE__)
+        return static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+        return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    }
 
-        return res;
+    bool makeDirectories(const std::string& path)
+    {
+        size_t pos = 0;
+        while ((pos = path.find('/', pos + 1)) != std::string::npos)
+        {
+            std::string dir = path.substr(0, pos);
+            if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+            {
+                return false;
+            }
+        }
+        return (mkdir(path.c_str(), 0755) == 0 || errno == EEXIST);
     }
 }
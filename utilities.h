@@ -1,14 +1,24 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstdint>
 
 namespace utilities
 {
-    std::string ltrim(const std::string& s);
-    std::string rtrim(const std::string& s);
-    std::string trim(const std::string &s);
-    std::vector<std::string> split(const std::string& s, char delimiter);
-    std::vector<std::string> getValueList(std::string value);
-    std::string normalizePath(std::string &path);
+    /* the views returned refer to the argument, which has to outlive them */
+    std::string_view ltrim(std::string_view s);
+    std::string_view rtrim(std::string_view s);
+    std::string_view trim(std::string_view s);
+    std::vector<std::string_view> split(std::string_view s, char delimiter);
+    std::vector<std::string_view> getValueList(std::string_view value);
+    void normalizePath(std::string &path);
+
+    uint64_t hash(const char* data, size_t length, uint64_t seed = 14695981039346656037ULL);
+    std::string toHex(uint64_t value);
+    bool readFile(const std::string& path, std::string& contents);
+    bool writeFileAtomic(const std::string& path, const std::string& contents);
+    int64_t getModifiedTime(const std::string& path, bool* isDirectory = nullptr);
+    bool makeDirectories(const std::string& path);
 }
@@ -0,0 +1,213 @@
+#include "watcher.h"
+
+#include <iostream>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <climits>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+static const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ATTRIB;
+
+watcher::watcher()
+{
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Error starting inotify");
+    }
+    debounce = 25;
+}
+
+watcher::~watcher()
+{
+    close(fd);
+}
+
+void watcher::setOptions(const project::options &o)
+{
+    opts = o;
+}
+
+void watcher::setDebounce(int milliseconds)
+{
+    debounce = milliseconds;
+}
+
+void watcher::add(std::string input, std::string output)
+{
+    targets.push_back({ input, output });
+    subscribe(targets.size() - 1);
+}
+
+void watcher::addWatch(const std::string& path, const std::string& name, size_t index)
+{
+    int wd = inotify_add_watch(fd, path.c_str(), WATCH_MASK | IN_ONLYDIR);
+    if (wd < 0)
+    {
+        return;
+    }
+    folder& f = folders[wd];
+    f.path = path;
+    f.names.push_back({ name, index });
+}
+
+/* the .jucer folder is always watched, so that a project that fails to parse is retried when it is saved */
+void watcher::subscribe(size_t index)
+{
+    auto const& t = targets[index];
+    std::vector<std::string> paths;
+    std::vector<std::string> dirs;
+    try
+    {
+        project proj(t.input, t.output, opts);
+        proj.get_watch_paths(paths, dirs);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        paths.assign(1, t.input);
+    }
+
+    for (auto const& path : paths)
+    {
+        size_t sep = path.find_last_of('/');
+        std::string dir = (sep == std::string::npos) ? "." : (sep == 0 ? "/" : path.substr(0, sep));
+        addWatch(dir, path.substr(sep + 1), index);
+    }
+    for (auto const& dir : dirs)
+    {
+        addWatch(dir, "", index);
+    }
+}
+
+void watcher::unsubscribe(size_t index)
+{
+    for (auto it = folders.begin(); it != folders.end();)
+    {
+        auto& names = it->second.names;
+        names.erase(std::remove_if(names.begin(), names.end(), [index](const std::pair<std::string, size_t>& n)
+        {
+            return n.second == index;
+        }), names.end());
+
+        if (names.empty())
+        {
+            inotify_rm_watch(fd, it->first);
+            it = folders.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+/* module paths may have changed with the .jucer, the watches are renewed after every run */
+void watcher::regenerate(size_t index)
+{
+    auto const& t = targets[index];
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        project proj(t.input, t.output, opts);
+        bool changed = proj.generate();
+        auto end = std::chrono::steady_clock::now();
+        std::cout << (changed ? "Created \"" : "Unchanged \"") << proj.get_output_file() << "\" ("
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms)" << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+    unsubscribe(index);
+    subscribe(index);
+}
+
+/*
+ * Blocks in poll() while nothing happens.  After an event the affected projects are collected
+ * until no event arrived for the debounce time, or for at most ten times that during a
+ * continuous stream of events.
+ */
+int watcher::run()
+{
+    std::cout << "Watching " << targets.size() << " projects in " << folders.size() << " folders" << std::endl;
+
+    alignas(struct inotify_event) char buffer[64 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+    std::set<size_t> pending;
+    auto first = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+        struct pollfd p = { fd, POLLIN, 0 };
+        int timeout = -1;
+        if (!pending.empty())
+        {
+            auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - first).count();
+            timeout = (waited >= debounce * 10) ? 0 : debounce;
+        }
+
+        int r = poll(&p, 1, timeout);
+        if (r < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << "Error waiting for file changes" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (r == 0)
+        {
+            for (auto index : pending)
+            {
+                regenerate(index);
+            }
+            pending.clear();
+            continue;
+        }
+
+        ssize_t n;
+        while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+        {
+            for (char* e = buffer; e < buffer + n; e += sizeof(struct inotify_event) + reinterpret_cast<struct inotify_event*>(e)->len)
+            {
+                auto event = reinterpret_cast<struct inotify_event*>(e);
+                if (pending.empty())
+                {
+                    first = std::chrono::steady_clock::now();
+                }
+
+                // events were lost, everything may have changed
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    for (size_t i = 0; i < targets.size(); i++)
+                    {
+                        pending.insert(i);
+                    }
+                    continue;
+                }
+
+                auto it = folders.find(event->wd);
+                if (it == folders.end())
+                {
+                    continue;
+                }
+                std::string name = event->len ? event->name : "";
+                for (auto const& entry : it->second.names)
+                {
+                    if (entry.first.empty() || entry.first == name)
+                    {
+                        pending.insert(entry.second);
+                    }
+                }
+            }
+        }
+    }
+}
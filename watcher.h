@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "project.h"
+
+/*
+ * Regenerates projects when their inputs change (--watch).  The parent folders of the
+ * watched files are watched with inotify, so files that editors replace by renaming are
+ * followed too.  Events are collected until the tree is quiet for the debounce time and
+ * only the projects they belong to are regenerated, through the stamp check of gen_cmake.
+ */
+class watcher
+{
+public:
+    watcher();
+    ~watcher();
+
+    void setOptions(const project::options &o);
+    void setDebounce(int milliseconds);
+    void add(std::string input, std::string output);
+    int run();
+
+private:
+    struct target
+    {
+        std::string input;
+        std::string output;
+    };
+
+    struct folder
+    {
+        std::string path;
+        // (file name, target), an empty name matches any file in the folder
+        std::vector<std::pair<std::string, size_t>> names;
+    };
+
+    void subscribe(size_t index);
+    void unsubscribe(size_t index);
+    void addWatch(const std::string& path, const std::string& name, size_t index);
+    void regenerate(size_t index);
+
+    int fd;
+    int debounce;
+    project::options opts;
+    std::vector<target> targets;
+    std::map<int, folder> folders;
+};